@@ -0,0 +1,318 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube.hpp"
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_verifier.hpp"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstdint>
+
+// Solves a corpus of seeded scrambles with every solver, checks every solution,
+// and compares the median/p99 solve time of the fastest of several passes and the
+// move counts with a baseline. Exits with 1 when a solution is wrong or a solver regressed.
+
+struct BenchResult {
+    std::string solver;
+    uint64_t seed;
+    int cube_num;
+    int scramble_len;
+    double median_us;
+    double p99_us;
+    double mean_moves;
+    int max_moves;
+    uint64_t solutions_hash;
+};
+
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " [--solvers basic,cfop,thistlethwaite,pocket,bidirectional] [--count N] [--seed N]"
+              << " [--scramble-len N] [--passes 5] [--baseline FILE] [--save FILE] [--threshold 0.2]"
+              << " [--p99-threshold 0.5] [--csv FILE]" << std::endl;
+}
+
+
+// Only raw std::mt19937 outputs are used, which the standard fixes,
+// so a seed gives the same corpus with every compiler
+static std::string GenerateScramble(std::mt19937& rng, const int& move_num) {
+    static const char* turn_suffixes[3] = {"", "2", "'"};
+    std::string moves;
+    int last_face = -1;
+    for (int i = 0; i < move_num; i ++) {
+        int face = rng() % 6;
+        while (face == last_face)
+            face = rng() % 6;
+        last_face = face;
+        if (i > 0)
+            moves += ' ';
+        moves += rb::move_chars[face];
+        moves += turn_suffixes[rng() % 3];
+    }
+    return moves;
+}
+
+
+static int CountMoves(const std::string& moves) {
+    int move_num = 0;
+    for (int i = 0; i < moves.length(); i ++)
+        if (moves[i] != ' ' && (i == 0 || moves[i - 1] == ' '))
+            move_num ++;
+    return move_num;
+}
+
+
+// The first pass checks every solution, and every pass is timed. Noise only ever slows
+// a pass down, so the least median and p99 of the passes are kept.
+static bool RunSolver(const std::string& name, const uint64_t& seed, const int& cube_num, const int& scramble_len,
+                      const int& pass_num, std::ostream* csv, BenchResult& result) {
+    int dim;
+    std::unique_ptr<rb::RubikCubeSolver> solver(rb::CreateSolver(name, dim));
+    if (!solver) {
+        std::cerr << "Unknown solver " << name << std::endl;
+        return false;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<rb::RubikCube> cubes;
+    for (int i = 0; i < cube_num; i ++) {
+        cubes.push_back(rb::RubikCube(dim));
+        cubes.back().Move(GenerateScramble(rng, scramble_len));
+    }
+
+    // Build the solver's tables and caches outside of the timed solves
+    solver->Solve(cubes[0]);
+
+    std::vector<double> times_us(cube_num);
+    uint64_t hash = 14695981039346656037ULL;    // FNV-1a over all solutions
+    int move_sum = 0;
+    result.max_moves = 0;
+    result.median_us = result.p99_us = std::numeric_limits<double>::infinity();
+    for (int pass = 0; pass < pass_num; pass ++) {
+        for (int i = 0; i < cube_num; i ++) {
+            auto start = std::chrono::steady_clock::now();
+            std::string moves = solver->Solve(cubes[i]);
+            auto end = std::chrono::steady_clock::now();
+            times_us[i] = std::chrono::duration<double, std::micro>(end - start).count();
+            if (pass > 0)
+                continue;
+
+            std::string colors = cubes[i].GetCubeString(true);
+            if (!rb::VerifySolution(colors.c_str(), moves, dim)) {
+                std::cerr << name << ": wrong solution for scramble " << i << ": " << moves << std::endl;
+                return false;
+            }
+
+            const int move_num = CountMoves(moves);
+            move_sum += move_num;
+            result.max_moves = std::max(result.max_moves, move_num);
+            for (int j = 0; j <= moves.length(); j ++)
+                hash = (hash ^ (unsigned char)((j < moves.length())? moves[j]: '\n')) * 1099511628211ULL;
+            if (csv)
+                *csv << name << "," << i << "," << move_num << "," << times_us[i] << std::endl;
+        }
+
+        std::sort(times_us.begin(), times_us.end());
+        result.median_us = std::min(result.median_us, times_us[cube_num / 2]);
+        result.p99_us = std::min(result.p99_us, times_us[std::min(cube_num - 1, cube_num * 99 / 100)]);
+    }
+
+    result.solver = name;
+    result.seed = seed;
+    result.cube_num = cube_num;
+    result.scramble_len = scramble_len;
+    result.mean_moves = (double)move_sum / cube_num;
+    result.solutions_hash = hash;
+    return true;
+}
+
+
+static bool LoadBaseline(const std::string& path, std::vector<BenchResult>& results) {
+    std::ifstream in(path.c_str());
+    if (!in)
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        BenchResult r;
+        if (fields >> r.solver >> r.seed >> r.cube_num >> r.scramble_len >> r.median_us >> r.p99_us
+                   >> r.mean_moves >> r.max_moves >> std::hex >> r.solutions_hash)
+            results.push_back(r);
+    }
+    return true;
+}
+
+
+static bool SaveBaseline(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path.c_str());
+    out << "# solver seed count scramble_len median_us p99_us mean_moves max_moves solutions_hash" << std::endl;
+    for (int i = 0; i < results.size(); i ++) {
+        const BenchResult &r = results[i];
+        out << r.solver << " " << r.seed << " " << r.cube_num << " " << r.scramble_len << " "
+            << r.median_us << " " << r.p99_us << " " << r.mean_moves << " " << r.max_moves << " "
+            << std::hex << r.solutions_hash << std::dec << std::endl;
+    }
+    return (bool)out;
+}
+
+
+static bool IsSameCorpus(const BenchResult& r, const BenchResult& other) {
+    return r.solver == other.solver && r.seed == other.seed && r.cube_num == other.cube_num &&
+           r.scramble_len == other.scramble_len;
+}
+
+
+// The median may grow by threshold and the p99, which a few slow solves move, by p99_threshold.
+// Moves may not grow at all, as they don't depend on the machine.
+static bool CompareWithBaseline(const BenchResult& r, const std::vector<BenchResult>& baseline, const double& threshold,
+                                const double& p99_threshold) {
+    bool is_found = false;
+    for (int i = 0; i < baseline.size(); i ++) {
+        const BenchResult &b = baseline[i];
+        is_found |= (b.solver == r.solver);
+        if (!IsSameCorpus(r, b))
+            continue;
+
+        bool is_passed = true;
+        if (r.median_us > b.median_us * (1 + threshold)) {
+            std::cout << "  median regressed: " << b.median_us << "us -> " << r.median_us << "us" << std::endl;
+            is_passed = false;
+        }
+        if (r.p99_us > b.p99_us * (1 + p99_threshold)) {
+            std::cout << "  p99 regressed: " << b.p99_us << "us -> " << r.p99_us << "us" << std::endl;
+            is_passed = false;
+        }
+        if (r.mean_moves > b.mean_moves + 0.005 || r.max_moves > b.max_moves) {
+            std::cout << "  moves regressed: mean " << b.mean_moves << " -> " << r.mean_moves
+                      << ", max " << b.max_moves << " -> " << r.max_moves << std::endl;
+            is_passed = false;
+        }
+        if (r.solutions_hash != b.solutions_hash)
+            std::cout << "  solutions differ from the baseline" << std::endl;
+        return is_passed;
+    }
+    if (is_found)
+        std::cout << "  baseline of " << r.solver << " is for another corpus, not compared" << std::endl;
+    else
+        std::cout << "  no baseline for " << r.solver << std::endl;
+    return true;
+}
+
+
+int main(int argc, char* argv[]) {
+    std::string solvers = "basic,cfop,thistlethwaite,pocket";
+    int cube_num = 1000;
+    uint64_t seed = 1;
+    int scramble_len = 25;
+    std::string baseline_path;
+    std::string save_path;
+    int pass_num = 5;
+    double threshold = 0.2;
+    double p99_threshold = 0.5;
+    std::string csv_path;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--solvers")
+            solvers = argv[i + 1];
+        else if (arg == "--count")
+            cube_num = std::atoi(argv[i + 1]);
+        else if (arg == "--seed")
+            seed = std::strtoull(argv[i + 1], NULL, 10);
+        else if (arg == "--scramble-len")
+            scramble_len = std::atoi(argv[i + 1]);
+        else if (arg == "--passes")
+            pass_num = std::atoi(argv[i + 1]);
+        else if (arg == "--baseline")
+            baseline_path = argv[i + 1];
+        else if (arg == "--save")
+            save_path = argv[i + 1];
+        else if (arg == "--threshold")
+            threshold = std::atof(argv[i + 1]);
+        else if (arg == "--p99-threshold")
+            p99_threshold = std::atof(argv[i + 1]);
+        else if (arg == "--csv")
+            csv_path = argv[i + 1];
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((argc % 2) == 0 || cube_num <= 0 || scramble_len <= 0 || pass_num <= 0 || threshold < 0 || p99_threshold < 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<BenchResult> baseline;
+    if (!baseline_path.empty() && !LoadBaseline(baseline_path, baseline)) {
+        std::cerr << "Can't read baseline " << baseline_path << std::endl;
+        return 1;
+    }
+    std::ofstream csv;
+    if (!csv_path.empty()) {
+        csv.open(csv_path.c_str());
+        csv << "solver,scramble,moves,us" << std::endl;
+    }
+
+    std::vector<BenchResult> results;
+    bool is_passed = true;
+    std::istringstream solver_names(solvers);
+    std::string name;
+    while (std::getline(solver_names, name, ',')) {
+        BenchResult result;
+        if (!RunSolver(name, seed, cube_num, scramble_len, pass_num, (csv.is_open())? &csv: NULL, result)) {
+            is_passed = false;
+            continue;
+        }
+        results.push_back(result);
+        std::cout << name << ": median " << result.median_us << "us, p99 " << result.p99_us << "us, moves mean "
+                  << result.mean_moves << " max " << result.max_moves << std::endl;
+        if (!baseline_path.empty())
+            is_passed &= CompareWithBaseline(result, baseline, threshold, p99_threshold);
+    }
+
+    // Results replace the saved lines of the same solver and corpus, the others are kept
+    std::vector<BenchResult> saved;
+    if (!save_path.empty() && LoadBaseline(save_path, saved)) {
+        for (int i = 0; i < results.size(); i ++) {
+            int j = 0;
+            while (j < saved.size() && !IsSameCorpus(results[i], saved[j]))
+                j ++;
+            if (j == saved.size())
+                saved.push_back(results[i]);
+            else
+                saved[j] = results[i];
+        }
+        results.swap(saved);
+    }
+    if (!save_path.empty() && !SaveBaseline(save_path, results)) {
+        std::cerr << "Can't write baseline " << save_path << std::endl;
+        return 1;
+    }
+
+    std::cout << ((is_passed)? "PASSED": "FAILED") << std::endl;
+    return (is_passed)? 0: 1;
+}
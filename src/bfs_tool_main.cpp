@@ -0,0 +1,73 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_3subgroup_bfs.hpp"
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <thread>
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " --moves \"U R\" [--pieces all|corners|edges] [--threads N]"
+              << " [--memory MB] [--spill-dir DIR]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string moves;
+    std::string pieces = "all";
+    int thread_num = std::thread::hardware_concurrency();
+    uint64_t max_memory = 1024;
+    std::string spill_dir = ".";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--moves")
+            moves = argv[i + 1];
+        else if (arg == "--pieces")
+            pieces = argv[i + 1];
+        else if (arg == "--threads")
+            thread_num = std::atoi(argv[i + 1]);
+        else if (arg == "--memory")
+            max_memory = std::strtoull(argv[i + 1], NULL, 10);
+        else if (arg == "--spill-dir")
+            spill_dir = argv[i + 1];
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((argc % 2) == 0 || moves.empty() || thread_num <= 0 || max_memory == 0 ||
+        (pieces != "all" && pieces != "corners" && pieces != "edges")) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    rb::SUBGROUP_PIECES subgroup_pieces = (pieces == "corners")? rb::CORNER_PIECES:
+                                          ((pieces == "edges")? rb::EDGE_PIECES: rb::ALL_PIECES);
+    rb::RubikCube3SubgroupBFS bfs(moves, subgroup_pieces);
+    std::cout << "Moves: " << bfs.GetMoves().size() << ", coordinate size: " << bfs.GetCoordNum() << std::endl;
+
+    std::vector<uint64_t> distribution = bfs.Run(thread_num, max_memory << 20, spill_dir);
+
+    uint64_t state_num = 0;
+    for (int d = 0; d < distribution.size(); d ++) {
+        std::cout << d << "\t" << distribution[d] << std::endl;
+        state_num += distribution[d];
+    }
+    std::cout << "Total states: " << state_num << std::endl;
+
+    return 0;
+}
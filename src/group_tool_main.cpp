@@ -0,0 +1,70 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_permutation.hpp"
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Read one algorithm per line from stdin. For every line print
+ *     order <tab> cycles <tab> inverse algorithm
+ * or, for a line "ALG1 = ALG2", whether both algorithms have the same effect.
+ */
+
+static bool IsValidAlgorithm(const std::string& moves) {
+    for (int i = 0; i < moves.length(); i ++)
+        if (moves[i] != ' ' && moves[i] != '\'' && moves[i] != 'i' && moves[i] != '2' &&
+            std::strchr(rb::move_chars, moves[i]) == NULL)
+            return false;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int dim = 3;
+    if (argc == 3 && std::string(argv[1]) == "--dim")
+        dim = std::atoi(argv[2]);
+    if ((argc != 1 && argc != 3) || dim < 3 || dim > 5) {
+        std::cout << "Usage: " << argv[0] << " [--dim 3|4|5] < algorithms" << std::endl;
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        size_t eq_pos = line.find('=');
+        std::string moves = line.substr(0, eq_pos);
+        std::string other_moves = (eq_pos == std::string::npos)? "": line.substr(eq_pos + 1);
+
+        if (!IsValidAlgorithm(moves) || !IsValidAlgorithm(other_moves)) {
+            std::cout << "invalid\n";
+            continue;
+        }
+
+        rb::RubikCubePermutation perm(moves, dim);
+        if (eq_pos != std::string::npos) {
+            std::cout << ((perm == rb::RubikCubePermutation(other_moves, dim))? "equal": "different") << '\n';
+            continue;
+        }
+
+        std::cout << perm.GetOrder() << '\t' << perm.GetCycleString() << '\t'
+                  << rb::RubikCubePermutation::InvertMoves(moves) << '\n';
+    }
+
+    return 0;
+}
@@ -33,12 +33,22 @@ int main() {
     std::cout << "Scramble cube again:" << std::endl;
     rb.Scramble();
     rb.Dump();
-    rb::RubikCubeSolver *solver = new rb::RubikCube3BasicSolver(rb);
-    moves = solver->Solve();
+    rb::RubikCube3BasicSolver solver;
+    moves = solver.Solve(rb);
 
     std::cout << "Moves solved by basic solver: " << moves << std::endl;
     rb.Move(moves);    
     rb.Dump();
 
+    std::cout << "Scramble cube again:" << std::endl;
+    rb.Scramble();
+    rb.Dump();
+    rb::RubikCube3CFOPSolver cfop_solver;
+    moves = cfop_solver.Solve(rb);
+
+    std::cout << "Moves solved by CFOP solver: " << moves << std::endl;
+    rb.Move(moves);
+    rb.Dump();
+
     return 0;
 }
\ No newline at end of file
@@ -14,6 +14,8 @@
  *   limitations under the License.
  */
 #include "rubik_cube.hpp"
+#include "rubik_cube_permutation.hpp"
+#include "rubik_cube_trace.hpp"
 
 #include <iostream>
 #include <cstring>
@@ -28,6 +30,9 @@ static const char* face_chars = "ULFRBD";
 
 static const int face_num = 6;
 
+// No cube has 64 pieces to match, so bit 63 can't be set in a valid mask
+static const uint64_t stale_match_mask = ~(uint64_t)0;
+
 enum FACE_CORNER {
     UL = 4,
     UR,
@@ -64,16 +69,41 @@ inline int GetSliceInfoIndex(int move_char_idx) {
 }
 
 
-inline int StrChrIdx(const char* str, const char& ch, const int& str_len) {
-    for (int i = 0; i < str_len; i ++)
-        if (str[i] == ch)
-            return i;
-    return -1;
+// Face index of every face char and index in move_chars of every move char,
+// -1 for other chars
+struct CharTables {
+    CharTables() {
+        std::memset(face_idxs, -1, sizeof(face_idxs));
+        std::memset(move_idxs, -1, sizeof(move_idxs));
+        for (int i = 0; i < face_num; i ++)
+            face_idxs[(unsigned char)face_chars[i]] = i;
+        for (int i = 0; move_chars[i]; i ++)
+            move_idxs[(unsigned char)move_chars[i]] = i;
+    }
+
+    signed char face_idxs[256];
+    signed char move_idxs[256];
+};
+
+
+static const CharTables& GetCharTables() {
+    static const CharTables tables;
+    return tables;
+}
+
+
+inline int GetFaceIdx(const char& face_char) {
+    return GetCharTables().face_idxs[(unsigned char)face_char];
+}
+
+
+inline int GetMoveCharIdx(const char& move_char) {
+    return GetCharTables().move_idxs[(unsigned char)move_char];
 }
 
 
 CUBE_FACE rb::CvtFaceCharToFace(const char& face_char) {
-    int index = StrChrIdx(face_chars, face_char, strlen(face_chars));
+    int index = GetFaceIdx(face_char);
     if (index < 0)
         return UNKNOWN_FACE;
     return (CUBE_FACE)index;
@@ -85,6 +115,8 @@ RubikCube::RubikCube(int dim/* = 3*/):
 
     face_mappings_ = new char[face_num + 1];
     std::strcpy(face_mappings_, face_chars);
+    for (int i = 0; i < face_num; i ++)
+        mapped_faces_[i] = i;
 
     color_mappings_ = new char[face_num + 1];
     std::strcpy(color_mappings_, "WOGRBY");
@@ -95,6 +127,7 @@ RubikCube::RubikCube(int dim/* = 3*/):
         std::memset(face, face_chars[i], piece_num_);
     }
     faces_[piece_num_ * face_num] = '\0';
+    match_mask_ = stale_match_mask;
 }
 
 
@@ -103,19 +136,27 @@ RubikCube::RubikCube(const char* colors, int dim/* = 3*/):
 
     face_mappings_ = new char[face_num + 1];
     std::strcpy(face_mappings_, face_chars);
+    for (int i = 0; i < face_num; i ++)
+        mapped_faces_[i] = i;
 
     color_mappings_ = new char[face_num + 1];
     MapColors(colors);
 
+    char color_face_chars[256] = {0};
+    for (int i = 0; i < face_num; i ++)
+        color_face_chars[(unsigned char)color_mappings_[i]] = face_chars[i];
+
     faces_ = new char[piece_num_ * face_num + 1];
     for (int i = 0; i < face_num; i ++) {
         char *face = &(faces_[piece_num_ * i]);
         const char *face_colors = &(colors[piece_num_ * i]);
         for (int j = 0; j < piece_num_; j ++) {
-            face[j] = ColorToFaceChar(face_colors[j]);
+            face[j] = color_face_chars[(unsigned char)face_colors[j]];
+            assert(face[j]);
         }
     }
     faces_[piece_num_ * face_num] = '\0';
+    match_mask_ = stale_match_mask;
 }
 
 
@@ -131,57 +172,66 @@ RubikCube::RubikCube(const RubikCube& other):
 
     face_mappings_ = new char[face_num + 1];
     std::strcpy(face_mappings_, other.face_mappings_);
+    std::memcpy(mapped_faces_, other.mapped_faces_, face_num);
 
     color_mappings_ = new char[face_num + 1];
     std::strcpy(color_mappings_, other.color_mappings_);
 
     faces_ = new char[piece_num_ * face_num + 1];
-    std::strcpy(faces_, other.faces_);
+    std::memcpy(faces_, other.faces_, piece_num_ * face_num + 1);
+    match_mask_ = other.match_mask_;
 }
 
 
 RubikCube& RubikCube::operator=(const RubikCube& other) {
-    delete [] faces_;
-    delete [] color_mappings_;
-    delete [] face_mappings_;
+    if (this == &other)
+        return *this;
+
+    // Keep the sticker buffer when the dimension is unchanged,
+    // so a cube can be reloaded without heap allocations.
+    if (piece_num_ != other.piece_num_) {
+        delete [] faces_;
+        faces_ = new char[other.piece_num_ * face_num + 1];
+    }
 
     dim_ = other.dim_;
     piece_num_ = other.piece_num_;
 
-    face_mappings_ = new char[face_num + 1];
     std::strcpy(face_mappings_, other.face_mappings_);
-
-    color_mappings_ = new char[face_num + 1];
+    std::memcpy(mapped_faces_, other.mapped_faces_, face_num);
     std::strcpy(color_mappings_, other.color_mappings_);
-
-    faces_ = new char[piece_num_ * face_num + 1];
-    std::strcpy(faces_, other.faces_);
+    std::memcpy(faces_, other.faces_, piece_num_ * face_num + 1);
+    match_mask_ = other.match_mask_;
 
     return *this;
 }
 
 
 void RubikCube::MapColors(const char* colors) {
-    if (dim_ == 3 || dim_ == 5) {
+    if (dim_ & 1) {
         for (int i = 0; i < face_num; i ++) {
             color_mappings_[i] = colors[(i * piece_num_) + (piece_num_ >> 1)];
         }
-    } else { // dim_ == 4
+    } else { // dim_ == 2 or 4, no center pieces, infer the colors from the corners
         static const int corner_coords[8][6] = {
-            {0, 12, 1,  3, 2,  0}, // ULF
-            {0, 15, 2,  3, 3,  0}, // UFR
-            {0,  3, 3,  3, 4,  0}, // URB
-            {0,  0, 4,  3, 1,  0}, // UBL
-            {5,  0, 1, 15, 2, 12}, // DLF
-            {5,  3, 2, 15, 3, 12}, // DFR
-            {5, 15, 3, 15, 4, 12}, // DRB
-            {5, 12, 4, 15, 1, 12}, // DBL
+            {0, DL, 1, UR, 2, UL}, // ULF
+            {0, DR, 2, UR, 3, UL}, // UFR
+            {0, UR, 3, UR, 4, UL}, // URB
+            {0, UL, 4, UR, 1, UL}, // UBL
+            {5, UL, 1, DR, 2, DL}, // DLF
+            {5, UR, 2, DR, 3, DL}, // DFR
+            {5, DR, 3, DR, 4, DL}, // DRB
+            {5, DL, 4, DR, 1, DL}, // DBL
+        };
+        const int corner_idxs[4] = {0, dim_ - 1, piece_num_ - 1, piece_num_ - dim_};   // UL, UR, DR, DL
+        auto corner_color = [&](const int& c, const int& i) {
+            return colors[corner_coords[c][i] * piece_num_ + corner_idxs[corner_coords[c][i + 1] - UL]];
         };
 
         std::map<char,int> color_index_map;
         int color_map_idx = 0;
         for (int i = 0; i < 6; i += 2) {
-            char color_char = colors[corner_coords[0][i] * piece_num_ + corner_coords[0][i + 1]];
+            char color_char = corner_color(0, i);
             color_index_map[color_char] = color_map_idx;
             color_mappings_[color_map_idx++] = color_char;
         }
@@ -193,7 +243,7 @@ void RubikCube::MapColors(const char* colors) {
                 char new_color_char = '\0';
 
                 for (int i = 0; i < 6; i += 2) {
-                    char color_char = colors[corner_coords[c][i] * piece_num_ + corner_coords[c][i + 1]];
+                    char color_char = corner_color(c, i);
                     if (color_index_map.find(color_char) != color_index_map.end()) {
                         corner_mask |= 1 << (color_index_map[color_char]);
                     } else {
@@ -259,19 +309,18 @@ char RubikCube::GetPieceChar(const CUBE_FACE& cube_face, const int& row, const i
 }
 
 
-char RubikCube::ColorToFaceChar(const char& color) {
-    int index = StrChrIdx(color_mappings_, color, std::strlen(color_mappings_));
-    assert(index >= 0);
-    return face_chars[index];
+char RubikCube::FaceCharToColor(const char& face_char) {
+    return color_mappings_[GetFaceIdx(face_char)];
 }
 
 
-char RubikCube::FaceCharToColor(const char& face_char) {
-    return color_mappings_[CvtFaceCharToFace(face_char)];
+CUBE_FACE RubikCube::GetPieceFace(const CUBE_FACE& cube_face, const int& row, const int& col) {
+    return (CUBE_FACE)mapped_faces_[GetFaceIdx(faces_[((int)cube_face * dim_ + row) * dim_ + col])];
 }
 
 
 void RubikCube::RotateCube(const ROTATE_CUBE_DIR& dir) {
+    RB_TRACE_SCOPE("RubikCube::RotateCube");
     static const CUBE_FACE rotate_fixed_faces[2] = {U, D};
     static const CUBE_FACE rotate_side_faces[4] = {L, F, R, B};
     static const CUBE_FACE roll_fixed_faces[2] = {L, R};
@@ -292,6 +341,8 @@ void RubikCube::RotateCube(const ROTATE_CUBE_DIR& dir) {
     }
     std::memcpy(&(faces_[side_faces[3] * piece_num_]), tmp_face, piece_num_);
     face_mappings_[side_faces[3]] = tmp_face_mapping;
+    for (int i = 0; i < 4; i ++)
+        mapped_faces_[GetFaceIdx(face_mappings_[side_faces[i]])] = side_faces[i];
 
     if (dir == ROLL) {
         for (int i = 0; i < 2; i ++) {
@@ -320,6 +371,7 @@ void RubikCube::RotateFace(const CUBE_FACE& rot_face, const ROTATE_DIR& dir, con
         }
     }
     std::memcpy(face, tmp_face, piece_num_);
+    match_mask_ = stale_match_mask;
 
     if (!face_only) {
         int slice_info_idx = GetSliceInfoIndex(rot_face);
@@ -332,6 +384,8 @@ void RubikCube::RotateFace(const CUBE_FACE& rot_face, const ROTATE_DIR& dir, con
 
 
 void RubikCube::RotateSlice(const CUBE_SLICE& rot_slice, const ROTATE_DIR& dir, const int &offset/* = 0*/) {
+    assert(dim_ > 2);     // 2x2x2 has no inner slices
+
     int slice_info_idx = GetSliceInfoIndex(rot_slice);
     ROTATE_DIR slice_dir = (ROTATE_DIR)((rot_slice == l || rot_slice == d || rot_slice == b)? (CCW - dir): dir);
     int slice_offset = 0;
@@ -394,11 +448,12 @@ void RubikCube::DoRotateSlice(const int& slice_info_idx, const ROTATE_DIR& dir,
         const SliceInfo &curr_s = si[ni % 4];
         n_faces[ni % 4][start_idx[ni % 4] + (i * curr_s.dir * ((curr_s.is_row)? 1: dim_))] = tmp_char;
     }
+    match_mask_ = stale_match_mask;
 }
 
 
 std::string RubikCube::Scramble(const int& move_count/* = 20*/) {
-    const int move_faces_num = (dim_ == 3)? 6: 12;
+    const int move_faces_num = (dim_ <= 3)? 6: 12;
     std::string ret_moves;
 
     std::srand(std::clock());
@@ -420,12 +475,13 @@ std::string RubikCube::Scramble(const int& move_count/* = 20*/) {
 
 
 void RubikCube::Move(const std::string& moves) {
+    RB_TRACE_SCOPE("RubikCube::Move");
     for (int i = 0; i < moves.length(); i ++)
     {
         if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
             continue;
 
-        int move_char_idx = StrChrIdx(move_chars, moves[i], strlen(move_chars));
+        int move_char_idx = GetMoveCharIdx(moves[i]);
         assert(move_char_idx >= 0);
 
         int move_cnt = 1;
@@ -439,11 +495,52 @@ void RubikCube::Move(const std::string& moves) {
                 move_cnt = 2;
         }
 
-        while (move_cnt--) {
-            if (move_char_idx < UNKNOWN_FACE)
-                RotateFace((CUBE_FACE)move_char_idx, rot_dir);
-            else
-                RotateSlice((CUBE_SLICE)move_char_idx, rot_dir);
+        while (move_cnt--)
+            DoMove(move_char_idx, rot_dir);
+    }
+}
+
+
+void RubikCube::Move(const RubikCubePermutation& perm) {
+    RB_TRACE_SCOPE("RubikCube::Move(permutation)");
+    assert(perm.GetDim() == dim_);
+
+    const int facelet_num = piece_num_ * face_num;
+    char tmp_faces[facelet_num];
+    perm.Apply(faces_, tmp_faces);
+    std::memcpy(faces_, tmp_faces, facelet_num);
+
+    // Follow the faces turned by x, y and z like RotateCube does
+    char tmp_face_mappings[face_num];
+    for (int i = 0; i < face_num; i ++)
+        tmp_face_mappings[i] = face_mappings_[perm.GetFaceSource(i)];
+    for (int i = 0; i < face_num; i ++) {
+        face_mappings_[i] = tmp_face_mappings[i];
+        mapped_faces_[GetFaceIdx(face_mappings_[i])] = i;
+    }
+    match_mask_ = stale_match_mask;
+}
+
+
+void RubikCube::DoMove(const int& move_char_idx, const ROTATE_DIR& dir) {
+    if (move_char_idx < UNKNOWN_FACE) {
+        RotateFace((CUBE_FACE)move_char_idx, dir);
+    } else if (move_char_idx < UNKNOWN_SLICE) {
+        RotateSlice((CUBE_SLICE)move_char_idx, dir);
+    } else {
+        // RotateCube turns like y and like x', x and z are composed of them
+        const int rotation = move_char_idx - UNKNOWN_SLICE;
+        if (rotation == 0) {
+            for (int i = 0; i < ((dir == CW)? 3: 1); i ++)
+                RotateCube(ROLL);
+        } else if (rotation == 1) {
+            for (int i = 0; i < ((dir == CW)? 1: 3); i ++)
+                RotateCube(ROTATE);
+        } else {
+            RotateCube(ROTATE);
+            DoMove(UNKNOWN_SLICE, (dir == CW)? CCW: CW);
+            for (int i = 0; i < 3; i ++)
+                RotateCube(ROTATE);
         }
     }
 }
@@ -455,7 +552,7 @@ void RubikCube::Inverse(const std::string& moves) {
         if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
             continue;
 
-        int move_char_idx = StrChrIdx(move_chars, moves[i], strlen(move_chars));
+        int move_char_idx = GetMoveCharIdx(moves[i]);
         assert(move_char_idx >= 0);
 
         int move_cnt = 1;
@@ -469,12 +566,8 @@ void RubikCube::Inverse(const std::string& moves) {
                 move_cnt = 2;
         }
 
-        while (move_cnt--) {
-            if (move_char_idx < UNKNOWN_FACE)
-                RotateFace((CUBE_FACE)move_char_idx, rot_dir);
-            else
-                RotateSlice((CUBE_SLICE)move_char_idx, rot_dir);
-        }
+        while (move_cnt--)
+            DoMove(move_char_idx, rot_dir);
     }
 }
 
@@ -503,7 +596,7 @@ std::string RubikCube::CompressMovesImpl(const std::string& moves) {
         if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
             continue;
 
-        int move_char_idx = StrChrIdx(move_chars, moves[i], strlen(move_chars));
+        int move_char_idx = GetMoveCharIdx(moves[i]);
         assert(move_char_idx >= 0);
 
         ROTATE_DIR rot_dir = CW;
@@ -562,12 +655,11 @@ std::string RubikCube::CompressMovesImpl(const std::string& moves) {
 
 
 std::string RubikCube::GetCubeString(const bool& is_color/* = false*/) {
-    char tmp_faces[std::strlen(faces_)];
-    std::strcpy(tmp_faces, faces_);
+    std::string cube_string(faces_, piece_num_ * face_num);
     if (is_color)
-        for (int i = 0; i < std::strlen(tmp_faces); i ++)
-            tmp_faces[i] = FaceCharToColor(tmp_faces[i]);
-    return std::string(tmp_faces);
+        for (int i = 0; i < cube_string.length(); i ++)
+            cube_string[i] = FaceCharToColor(cube_string[i]);
+    return cube_string;
 }
 
 
@@ -585,4 +677,21 @@ bool RubikCube::IsSolved() {
 
 char RubikCube::GetMappedFaceChar(const CUBE_FACE& cube_face) {
     return face_mappings_[cube_face];
-}
\ No newline at end of file
+}
+
+
+uint64_t RubikCube::GetMatchMask() {
+    assert(piece_num_ * face_num <= 64);
+
+    if (match_mask_ == stale_match_mask) {
+        uint64_t mask = 0;
+        for (int i = 0; i < face_num; i ++) {
+            const char *face = &(faces_[i * piece_num_]);
+            const char face_char = face_mappings_[i];
+            for (int j = 0; j < piece_num_; j ++)
+                mask |= (uint64_t)(face[j] == face_char) << (i * piece_num_ + j);
+        }
+        match_mask_ = mask;
+    }
+    return match_mask_;
+}
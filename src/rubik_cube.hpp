@@ -17,6 +17,7 @@
 
 #include <string>
 #include <cstring>
+#include <cstdint>
 #include <cassert>
 
 
@@ -63,11 +64,15 @@ enum FACE_EDGE {
 };
 
 
-static const char* move_chars = "ULFRBDulfrbdXYZ";
+// Face turns, inner slice turns, then x, y and z turning the whole cube like R, U and F,
+// indexed from UNKNOWN_SLICE
+static const char* move_chars = "ULFRBDulfrbdXYZxyz";
 
 
 CUBE_FACE CvtFaceCharToFace(const char& face_char);
 
+class RubikCubePermutation;
+
 
 class RubikCube {
   public:
@@ -82,24 +87,35 @@ class RubikCube {
     std::string GetCubeString(const bool& is_color = false);
     char GetMappedFaceChar(const CUBE_FACE& cube_face);
     char GetPieceChar(const CUBE_FACE& cube_face, const int& row, const int& col, const bool& is_color);
-    int GetDim() { return dim_; }
+    // The face of the current orientation which the piece belongs to,
+    // i.e. the face whose GetMappedFaceChar() is the piece char
+    CUBE_FACE GetPieceFace(const CUBE_FACE& cube_face, const int& row, const int& col);
+    int GetDim() const { return dim_; }
+    // Bit ((face * dim + row) * dim + col) is set when that piece matches the mapped
+    // face char of its face, for cubes up to 3x3x3. Moves only mark the mask stale and
+    // it is rebuilt on the next call, so all checks between two moves share one build.
+    uint64_t GetMatchMask();
 
     std::string Scramble(const int& Move_count = 20);
     void Move(const std::string& Moves);
+    // Apply a compiled move sequence in one pass
+    void Move(const RubikCubePermutation& perm);
     void Inverse(const std::string& Moves);
     void RotateCube(const ROTATE_CUBE_DIR& dir);
 
     std::string CompressMoves(const std::string& Moves);
 
   private:
+    friend class RubikCubePermutation;
+
     void MapColors(const char* colors);
 
-    char ColorToFaceChar(const char& color);
     char FaceCharToColor(const char& face_char);
 
     void RotateFace(const CUBE_FACE& rot_face, const ROTATE_DIR& dir, const bool& face_only = false);
     void RotateSlice(const CUBE_SLICE& rot_slice, const ROTATE_DIR& dir, const int& offset = 0);
     void DoRotateSlice(const int& slice_info_idx, const ROTATE_DIR& dir, const int& offset = 0);
+    void DoMove(const int& move_char_idx, const ROTATE_DIR& dir);
     std::string CompressMovesImpl(const std::string& Moves);
 
     int dim_;
@@ -107,6 +123,8 @@ class RubikCube {
     char* faces_;
     char* color_mappings_;
     char* face_mappings_;
+    char mapped_faces_[UNKNOWN_FACE];    // face of every face char in face_mappings_
+    uint64_t match_mask_;
 };
 
 }
\ No newline at end of file
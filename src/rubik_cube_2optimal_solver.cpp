@@ -0,0 +1,408 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_3cubie.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+using namespace rb;
+
+// The UFL corner is kept in place, so only R, B and D turns are used, and the
+// state is the permutation of the other 7 corners and the twist of 6 of them.
+static const int corner_perm_num = 5040;
+static const int corner_twist_num = 729;
+static const int state_num = corner_perm_num * corner_twist_num;
+static const int table_bytes = state_num / 4;     // distance mod 3, 2 bits per state
+static const unsigned char unknown_dist = 3;
+
+static const int move_faces[3] = {R, B, D};
+static const int move_num = 9;
+static const int moving_corners[7] = {URF, ULB, UBR, DFR, DLF, DBL, DRB};
+
+// 2x2x2 facelet i is at the corner of 3x3x3 facelet idx_3x3[i]
+static const int idx_3x3[4] = {0, 2, 6, 8};
+
+
+struct PocketTables {
+    PocketTables();
+
+    int GetPermCoord(const RubikCube3Cubie& cubie) const;
+    int GetTwistCoord(const RubikCube3Cubie& cubie) const;
+    void SetCoords(const int& perm, const int& twist, RubikCube3Cubie& cubie) const;
+
+    int local_idxs[CORNER_NUM];
+    std::vector<unsigned short> perm_moves;
+    std::vector<unsigned short> twist_moves;
+};
+
+
+PocketTables::PocketTables() {
+    for (int i = 0; i < 7; i ++)
+        local_idxs[moving_corners[i]] = i;
+
+    perm_moves.resize(corner_perm_num * move_num);
+    twist_moves.resize(corner_twist_num * move_num);
+    for (int m = 0; m < move_num; m ++) {
+        const RubikCube3Cubie &move = RubikCube3Cubie::GetMoveCubie(move_faces[m / 3] * 3 + m % 3);
+        for (int perm = 0; perm < corner_perm_num; perm ++) {
+            RubikCube3Cubie cubie;
+            SetCoords(perm, 0, cubie);
+            cubie.Multiply(move);
+            perm_moves[perm * move_num + m] = GetPermCoord(cubie);
+        }
+        for (int twist = 0; twist < corner_twist_num; twist ++) {
+            RubikCube3Cubie cubie;
+            SetCoords(0, twist, cubie);
+            cubie.Multiply(move);
+            twist_moves[twist * move_num + m] = GetTwistCoord(cubie);
+        }
+    }
+}
+
+
+int PocketTables::GetPermCoord(const RubikCube3Cubie& cubie) const {
+    int rank = 0;
+    int used_mask = 0;
+    for (int i = 0; i < 7; i ++) {
+        int piece = local_idxs[cubie.cp[moving_corners[i]]];
+        rank = rank * (7 - i) + (piece - __builtin_popcount(used_mask & ((1 << piece) - 1)));
+        used_mask |= 1 << piece;
+    }
+    return rank;
+}
+
+
+int PocketTables::GetTwistCoord(const RubikCube3Cubie& cubie) const {
+    int twist = 0;
+    for (int i = 0; i < 6; i ++)
+        twist = twist * 3 + cubie.co[moving_corners[i]];
+    return twist;
+}
+
+
+void PocketTables::SetCoords(const int& perm, const int& twist, RubikCube3Cubie& cubie) const {
+    int digits[7];
+    int rank = perm;
+    for (int i = 6; i >= 0; i --) {
+        digits[i] = rank % (7 - i);
+        rank /= (7 - i);
+    }
+    int used_mask = 0;
+    for (int i = 0; i < 7; i ++) {
+        int piece = 0;
+        for (int k = digits[i]; ; piece ++)
+            if (!(used_mask & (1 << piece)) && (k -- == 0))
+                break;
+        used_mask |= 1 << piece;
+        cubie.cp[moving_corners[i]] = moving_corners[piece];
+    }
+
+    int twist_sum = 0;
+    int t = twist;
+    for (int i = 5; i >= 0; i --) {
+        cubie.co[moving_corners[i]] = t % 3;
+        twist_sum += t % 3;
+        t /= 3;
+    }
+    cubie.co[moving_corners[6]] = (3 - twist_sum % 3) % 3;
+}
+
+
+static const PocketTables& GetPocketTables() {
+    static const PocketTables tables;
+    return tables;
+}
+
+
+inline int GetDist(const unsigned char* table, const int& idx) {
+    return (table[idx >> 2] >> ((idx & 3) << 1)) & 3;
+}
+
+
+// Breadth-first search from the solved state, storing distance mod 3
+static void BuildDistTable(unsigned char* table) {
+    const PocketTables &tables = GetPocketTables();
+    std::memset(table, 0xff, table_bytes);
+
+    std::vector<int> frontier(1, 0), next_frontier;
+    table[0] &= ~3;
+    for (int depth = 1; !frontier.empty(); depth ++) {
+        next_frontier.clear();
+        for (int i = 0; i < frontier.size(); i ++) {
+            const int perm = frontier[i] / corner_twist_num;
+            const int twist = frontier[i] % corner_twist_num;
+            for (int m = 0; m < move_num; m ++) {
+                int idx = tables.perm_moves[perm * move_num + m] * corner_twist_num +
+                          tables.twist_moves[twist * move_num + m];
+                if (GetDist(table, idx) != unknown_dist)
+                    continue;
+                table[idx >> 2] ^= (unknown_dist ^ (depth % 3)) << ((idx & 3) << 1);
+                next_frontier.push_back(idx);
+            }
+        }
+        frontier.swap(next_frontier);
+    }
+}
+
+
+static std::mutex table_mutex;
+static std::atomic<const unsigned char*> dist_table(NULL);
+// Copies of the table on every NUMA node, when loaded replicated
+static std::atomic<const unsigned char*> node_dist_tables[max_numa_node_num];
+
+
+static const unsigned char* GetDistTable() {
+    const unsigned char *table = node_dist_tables[GetCurrentNumaNode()].load(std::memory_order_acquire);
+    if (table)
+        return table;
+    table = dist_table.load(std::memory_order_acquire);
+    if (table)
+        return table;
+
+    std::lock_guard<std::mutex> lock(table_mutex);
+    if (!dist_table.load(std::memory_order_relaxed)) {
+        unsigned char *new_table = new unsigned char[table_bytes];
+        BuildDistTable(new_table);
+        dist_table.store(new_table, std::memory_order_release);
+    }
+    return dist_table.load(std::memory_order_relaxed);
+}
+
+
+bool RubikCube2OptimalSolver::LoadTable(const std::string& path, const TableMemoryOptions& options/* = TableMemoryOptions()*/) {
+    std::lock_guard<std::mutex> lock(table_mutex);
+    if (dist_table.load(std::memory_order_relaxed))
+        return true;
+
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || st.st_size != table_bytes) {
+        // Build the table once and save it, renaming so readers never see a partial file
+        std::vector<unsigned char> table(table_bytes);
+        BuildDistTable(&table[0]);
+
+        const std::string tmp_path = path + ".tmp";
+        FILE *fp = std::fopen(tmp_path.c_str(), "wb");
+        if (!fp)
+            return false;
+        bool is_written = (std::fwrite(&table[0], 1, table_bytes, fp) == table_bytes);
+        is_written &= (std::fclose(fp) == 0);
+        if (!is_written || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+    }
+
+    if (options.huge_pages == NO_HUGE_PAGES && !options.is_numa_replicated) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        void *mem = mmap(NULL, table_bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED)
+            return false;
+
+        dist_table.store((const unsigned char*)mem, std::memory_order_release);
+        return true;
+    }
+
+    // File pages can't be huge pages or copied per node, so read the file into table memory,
+    // the first copy unbound unless replicated
+    const int node_num = (options.is_numa_replicated)? GetNumaNodeNum(): 1;
+    std::vector<unsigned char*> tables(node_num, (unsigned char*)NULL);
+    bool is_read = true;
+    for (int n = 0; n < node_num && is_read; n ++) {
+        tables[n] = (unsigned char*)AllocTableMemory(table_bytes, options.huge_pages,
+                                                     (options.is_numa_replicated)? n: -1);
+        FILE *fp = std::fopen(path.c_str(), "rb");
+        is_read = tables[n] && fp && std::fread(tables[n], 1, table_bytes, fp) == table_bytes;
+        if (fp)
+            std::fclose(fp);
+    }
+    if (!is_read) {
+        for (int n = 0; n < node_num; n ++)
+            FreeTableMemory(tables[n], table_bytes);
+        return false;
+    }
+
+    if (options.is_numa_replicated)
+        for (int n = 0; n < node_num; n ++)
+            node_dist_tables[n].store(tables[n], std::memory_order_release);
+    dist_table.store(tables[0], std::memory_order_release);
+    return true;
+}
+
+
+// Orient cube_ so its U, L and F colored corner is at UFL and get its coordinates, the
+// costs of the 9 moves in the metric and the face chars MoveCube would give them out by
+void RubikCube2OptimalSolver::StartSolve(int& perm, int& twist, double* move_costs, char* face_chars) {
+    const PocketTables &tables = GetPocketTables();
+
+    // Turn the whole cube until the U, L and F colored corner is at UFL, so
+    // solving it only takes R, B and D turns
+    // Visit the 24 orientations as 4 rotations of each face turned up
+    bool is_oriented = false;
+    for (int i = 0; i < 24; i ++) {
+        is_oriented = (cube_.GetPieceChar(U, 1, 0, false) == 'U' && cube_.GetPieceChar(L, 0, 1, false) == 'L' &&
+                       cube_.GetPieceChar(F, 0, 0, false) == 'F');
+        if (is_oriented)
+            break;
+
+        cube_.RotateCube(ROTATE);
+        if ((i % 4) == 3) {
+            // Rolls bring up the faces around L and R, then L and R themselves
+            if ((i / 4) == 3)
+                cube_.RotateCube(ROTATE);
+            cube_.RotateCube(ROLL);
+            if ((i / 4) == 4)
+                cube_.RotateCube(ROLL);
+        }
+    }
+    assert(is_oriented);
+
+    unsigned char facelet_faces[UNKNOWN_FACE * 9];
+    for (int f = 0; f < UNKNOWN_FACE; f ++) {
+        std::memset(&facelet_faces[f * 9], f, 9);
+        for (int i = 0; i < 4; i ++)
+            facelet_faces[f * 9 + idx_3x3[i]] = CvtFaceCharToFace(cube_.GetPieceChar((CUBE_FACE)f, i / 2, i % 2, false));
+    }
+    RubikCube3Cubie cubie;
+    CUBE_STATE state = cubie.SetFacelets(facelet_faces);
+    assert(state == CUBE_STATE_VALID);
+    (void)state;
+
+    perm = tables.GetPermCoord(cubie);
+    twist = tables.GetTwistCoord(cubie);
+    for (int m = 0; m < move_num; m ++)
+        move_costs[m] = GetMoveCost((CUBE_FACE)move_faces[m / 3], m % 3);
+    for (int i = 0; i < 3; i ++)
+        face_chars[i] = cube_.GetMappedFaceChar((CUBE_FACE)move_faces[i]);
+}
+
+
+// Every move to a neighbor one closer to solved is a step of an optimal solution,
+// take the cheapest of them in the metric
+static int GetNextMove(const PocketTables& tables, const unsigned char* table, const int& perm, const int& twist,
+                       const double* move_costs) {
+    const int closer_dist = (GetDist(table, perm * corner_twist_num + twist) + 2) % 3;
+    int best_move = -1;
+    for (int m = 0; m < move_num; m ++) {
+        const int next_perm = tables.perm_moves[perm * move_num + m];
+        const int next_twist = tables.twist_moves[twist * move_num + m];
+        if (GetDist(table, next_perm * corner_twist_num + next_twist) == closer_dist &&
+            (best_move < 0 || move_costs[m] < move_costs[best_move]))
+            best_move = m;
+    }
+    assert(best_move >= 0);
+    return best_move;
+}
+
+
+// Start loading the distances GetNextMove reads next into the cache
+static void PrefetchNextMoves(const PocketTables& tables, const unsigned char* table, const int& perm, const int& twist) {
+    __builtin_prefetch(&table[(perm * corner_twist_num + twist) >> 2]);
+    for (int m = 0; m < move_num; m ++) {
+        const int idx = tables.perm_moves[perm * move_num + m] * corner_twist_num + tables.twist_moves[twist * move_num + m];
+        __builtin_prefetch(&table[idx >> 2]);
+    }
+}
+
+
+std::string RubikCube2OptimalSolver::DoSolve() {
+    const PocketTables &tables = GetPocketTables();
+    const unsigned char *table = GetDistTable();
+
+    int perm, twist;
+    double move_costs[move_num];
+    char face_chars[3];
+    StartSolve(perm, twist, move_costs, face_chars);
+
+    std::string moves;
+    while (perm || twist) {
+        const int m = GetNextMove(tables, table, perm, twist, move_costs);
+        perm = tables.perm_moves[perm * move_num + m];
+        twist = tables.twist_moves[twist * move_num + m];
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(move_faces[m / 3] * 3 + m % 3));
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// A solve of SolveBatch in progress
+struct PocketSolve {
+    int cube_idx;
+    int perm;
+    int twist;
+    double move_costs[move_num];
+    char face_chars[3];
+    std::string moves;
+};
+
+
+void RubikCube2OptimalSolver::SolveBatch(const std::vector<RubikCube>& cubes, std::vector<std::string>& solutions,
+                                         const int& interleave_num/* = pocket_interleave_num*/) {
+    static const char* turn_suffixes[3] = {" ", "2 ", "' "};
+    const PocketTables &tables = GetPocketTables();
+    const unsigned char *table = GetDistTable();
+    assert(interleave_num > 0);
+
+    solutions.assign(cubes.size(), std::string());
+    std::vector<PocketSolve> solves(std::min((int)cubes.size(), interleave_num));
+    int next_cube_idx = 0;
+    int active_num = 0;
+
+    // Each pass advances every solve by one move, whose table lines were prefetched
+    // a pass earlier while the other solves were advanced
+    for (int i = 0; i < solves.size(); i ++)
+        solves[i].cube_idx = -1;
+    do {
+        active_num = 0;
+        for (int i = 0; i < solves.size(); i ++) {
+            PocketSolve &solve = solves[i];
+            if (solve.cube_idx >= 0 && !solve.perm && !solve.twist) {
+                solutions[solve.cube_idx] = cube_.CompressMoves(solve.moves);
+                solve.cube_idx = -1;
+            }
+            if (solve.cube_idx < 0) {
+                if (next_cube_idx == cubes.size())
+                    continue;
+                solve.cube_idx = next_cube_idx ++;
+                solve.moves.clear();
+                Reset(cubes[solve.cube_idx]);
+                StartSolve(solve.perm, solve.twist, solve.move_costs, solve.face_chars);
+            } else {
+                const int m = GetNextMove(tables, table, solve.perm, solve.twist, solve.move_costs);
+                solve.perm = tables.perm_moves[solve.perm * move_num + m];
+                solve.twist = tables.twist_moves[solve.twist * move_num + m];
+                solve.moves += solve.face_chars[m / 3];
+                solve.moves += turn_suffixes[m % 3];
+            }
+            PrefetchNextMoves(tables, table, solve.perm, solve.twist);
+            active_num ++;
+        }
+    } while (active_num > 0);
+}
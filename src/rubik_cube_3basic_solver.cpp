@@ -14,6 +14,7 @@
  *   limitations under the License.
  */
 #include "rubik_cube_solver.hpp"
+#include "rubik_cube_trace.hpp"
 
 #include <iostream>
 #include <cassert>
@@ -29,6 +30,27 @@ static const PieceCoord edge_pieces[4] = {
     {1, 0}, {2, 1}, {1, 2}, {0, 1}
 };
 
+// Piece bits of one face in RubikCube::GetMatchMask()
+static const uint64_t face_edges_mask = 0xaa;      // (0, 1), (1, 0), (1, 2), (2, 1)
+static const uint64_t face_corners_mask = 0x145;   // (0, 0), (0, 2), (2, 0), (2, 2)
+
+inline uint64_t GetPieceMask(const CUBE_FACE& f, const int& row, const int& col) {
+    return (uint64_t)1 << ((f * 3 + row) * 3 + col);
+}
+
+inline uint64_t GetSideFacesMask(const int& row, const int& col) {
+    return GetPieceMask(L, row, col) | GetPieceMask(F, row, col) |
+           GetPieceMask(R, row, col) | GetPieceMask(B, row, col);
+}
+
+// The three pieces of every DOWN layer corner, DLF first
+static const int down_corner_pieces[4][3][3] = {
+    {{F, 2, 0}, {L, 2, 2}, {D, 0, 0}},
+    {{R, 2, 0}, {F, 2, 2}, {D, 0, 2}},
+    {{B, 2, 0}, {R, 2, 2}, {D, 2, 2}},
+    {{L, 2, 0}, {B, 2, 2}, {D, 2, 0}},
+};
+
 struct UpCrossCheckData {
     CUBE_FACE chk_face;
     int chk_edge_idx;
@@ -46,6 +68,7 @@ static const UpCrossCheckData up_cross_check_data[5] = {
 
 
 std::string RubikCube3BasicSolver::DoSolve() {
+    RB_TRACE_SCOPE("BasicSolver::Solve");
     std::string moves;
 
     FindBestCubeOrientation();
@@ -76,40 +99,29 @@ bool RubikCube3BasicSolver::IsUpCrossSolved() {
 
 
 inline bool RubikCube3BasicSolver::IsCrossOriented(const CUBE_FACE& f) {
-    char f_char = cube_.GetMappedFaceChar(f);
-    return (cube_.GetPieceChar(f, 0, 1, false) == f_char &&
-            cube_.GetPieceChar(f, 1, 0, false) == f_char &&
-            cube_.GetPieceChar(f, 1, 2, false) == f_char &&
-            cube_.GetPieceChar(f, 2, 1, false) == f_char);
+    return ((cube_.GetMatchMask() >> (f * 9)) & face_edges_mask) == face_edges_mask;
 }
 
 
 inline bool RubikCube3BasicSolver::IsCornerOriented(const CUBE_FACE& f) {
-    char f_char = cube_.GetMappedFaceChar(f);
-    return (cube_.GetPieceChar(f, 0, 0, false) == f_char &&
-            cube_.GetPieceChar(f, 0, 2, false) == f_char &&
-            cube_.GetPieceChar(f, 2, 0, false) == f_char &&
-            cube_.GetPieceChar(f, 2, 2, false) == f_char);
+    return ((cube_.GetMatchMask() >> (f * 9)) & face_corners_mask) == face_corners_mask;
 }
 
 
 inline int RubikCube3BasicSolver::GetCrossMatchCount(const FACE_EDGE& fe) {
-    int match_cnt = 0;
     const PieceCoord &ep = edge_pieces[fe];
-    for (int i = (int)L; i <= (int)B; i ++)
-        if (cube_.GetPieceChar((CUBE_FACE)i, ep.row, ep.col, false) ==
-            cube_.GetMappedFaceChar((CUBE_FACE)i))
-            match_cnt ++;
-    return match_cnt;
+    return __builtin_popcountll(cube_.GetMatchMask() & GetSideFacesMask(ep.row, ep.col));
 }
 
 
 std::string RubikCube3BasicSolver::SolveUpCross() {
+    RB_TRACE_SCOPE("BasicSolver::SolveUpCross");
     std::string moves;
     int prev_moves_len = -1;
     const char u_face = cube_.GetMappedFaceChar(U);
 
     while (!IsCrossOriented(U)) {
+        RB_TRACE_SCOPE("Orient up cross edges");
         prev_moves_len = -1;
         while (moves.length() != prev_moves_len) {
             prev_moves_len = moves.length();
@@ -146,6 +158,7 @@ std::string RubikCube3BasicSolver::SolveUpCross() {
         moves += MoveCube("U");
 
     while (GetCrossMatchCount(UE) < 4) {
+        RB_TRACE_SCOPE("Permute up cross edges");
         while (cube_.GetPieceChar(F, 0, 1, false) == cube_.GetMappedFaceChar(F)) {
             cube_.RotateCube(ROTATE);
         }
@@ -164,27 +177,18 @@ std::string RubikCube3BasicSolver::SolveUpCross() {
 
 // Step 2: Up Corners
 bool RubikCube3BasicSolver::IsUpCornersSolved() {
-    const char u_face = cube_.GetMappedFaceChar(U);
-
-    if (cube_.GetPieceChar(U, 0, 0, false) != u_face ||
-        cube_.GetPieceChar(U, 0, 2, false) != u_face ||
-        cube_.GetPieceChar(U, 2, 0, false) != u_face ||
-        cube_.GetPieceChar(U, 2, 2, false) != u_face)
-        return false;
-
-    for (int i = (int)L; i <= (int)B; i ++)
-        if (cube_.GetPieceChar((CUBE_FACE)i, 0, 0, false) != cube_.GetMappedFaceChar((CUBE_FACE)i))
-            return false;
-
-    return true;
+    const uint64_t solved_mask = (face_corners_mask << (U * 9)) | GetSideFacesMask(0, 0);
+    return (cube_.GetMatchMask() & solved_mask) == solved_mask;
 }
 
 
 std::string RubikCube3BasicSolver::SolveUpCorners() {
+    RB_TRACE_SCOPE("BasicSolver::SolveUpCorners");
     std::string moves;
     const char u_face = cube_.GetMappedFaceChar(U);
 
     while (!IsUpCornersSolved()) {
+        RB_TRACE_SCOPE("Place up corner");
         char f_face = cube_.GetMappedFaceChar(F);
         char r_face = cube_.GetMappedFaceChar(R);
 
@@ -227,22 +231,20 @@ std::string RubikCube3BasicSolver::SolveUpCorners() {
 
 // Step 3: Second Layer
 bool RubikCube3BasicSolver::IsSecondLayerSolved() {
-    for (int i = (int)L; i <= (int)B; i ++)
-        if (cube_.GetPieceChar((CUBE_FACE)i, 1, 0, false) != cube_.GetMappedFaceChar((CUBE_FACE)i) ||
-            cube_.GetPieceChar((CUBE_FACE)i, 1, 2, false) != cube_.GetMappedFaceChar((CUBE_FACE)i))
-            return false;
-
-    return true;
+    const uint64_t solved_mask = GetSideFacesMask(1, 0) | GetSideFacesMask(1, 2);
+    return (cube_.GetMatchMask() & solved_mask) == solved_mask;
 }
 
 
 std::string RubikCube3BasicSolver::SolveSecondLayer() {
+    RB_TRACE_SCOPE("BasicSolver::SolveSecondLayer");
     static const int down_edges[4][2] = { {F, UE}, {L, LE}, {B, DE}, {R, RE} };
 
     std::string moves;
     char d_face = cube_.GetMappedFaceChar(D);
 
     while (!IsSecondLayerSolved()) {
+        RB_TRACE_SCOPE("Place second layer edges");
         // Search the edges of 2nd layer on 3rd layer.
         // If any edge matches the current FRONT face,
         // rotate the edge to FRONT face and move it to right position.
@@ -261,7 +263,7 @@ std::string RubikCube3BasicSolver::SolveSecondLayer() {
 
                     if (cube_.GetPieceChar(chk_face, 2, 1, false) == f_face &&
                         edge_d_face != d_face) {
-                        //std::cout << std::string("Move edge[") + f_face + ", " + edge_d_face + "] to 2nd layer" << std::endl;
+                        RB_TRACE_INSTANT("Move edge to 2nd layer");
                         // Rotate the matched edge to face FRONT
                         std::string rot_moves = std::string(i, 'D');
                         moves += MoveCube(rot_moves);
@@ -288,7 +290,7 @@ std::string RubikCube3BasicSolver::SolveSecondLayer() {
 
             if ((f_edge != f_face || r_edge != r_face) &&
                 (f_edge != d_face && r_edge != d_face)) {
-                //std::cout << std::string("Move edge[") + f_edge + ", " + r_edge + "] to 3rd layer" << std::endl;
+                RB_TRACE_INSTANT("Move edge to 3rd layer");
                 for (int j = 0; j < 3; j ++) {
                     if (cube_.GetPieceChar(D, 1, 0, false) == d_face ||
                         cube_.GetPieceChar(L, 2, 1, false) == d_face)
@@ -313,17 +315,19 @@ bool RubikCube3BasicSolver::IsDownCrossSolved() {
 
 
 std::string RubikCube3BasicSolver::SolveDownCross() {
+    RB_TRACE_SCOPE("BasicSolver::SolveDownCross");
     std::string moves;
     char d_face = cube_.GetMappedFaceChar(D);
 
     // Solve DOWN face cross orientation
     while (!IsCrossOriented(D)) {
+        RB_TRACE_SCOPE("Orient down cross edges");
         if (cube_.GetPieceChar(D, 0, 1, false) != d_face) {
             if (cube_.GetPieceChar(D, 1, 0, false) != d_face) {
-                //std::cout << "Solve L shape" << std::endl;
+                RB_TRACE_INSTANT("Solve L shape");
                 moves += MoveCube("F D L D' L' F'");
             } else if (cube_.GetPieceChar(D, 2, 1, false) != d_face) {
-                //std::cout << "Solve I shape" << std::endl;
+                RB_TRACE_INSTANT("Solve I shape");
                 moves += MoveCube("F L D L' D' F'");
             }
         }
@@ -356,10 +360,10 @@ std::string RubikCube3BasicSolver::SolveDownCross() {
         }
 
         if (cube_.GetPieceChar(R, 2, 1, false) != cube_.GetMappedFaceChar(R)) {
-            //std::cout << "Solve L shape permutation" << std::endl;
+            RB_TRACE_INSTANT("Solve L shape permutation");
             moves += MoveCube("L D L' D L D2 L' D");
         } else {
-            //std::cout << "Solve I shape permutation" << std::endl;
+            RB_TRACE_INSTANT("Solve I shape permutation");
             moves += MoveCube("L D L' D L D2 L' D' L D L' D L D2 L'");
         }
     }
@@ -370,20 +374,14 @@ std::string RubikCube3BasicSolver::SolveDownCross() {
 
 
 // Step 5: Down Corners
-inline bool RubikCube3BasicSolver::IsDownCornerMatched() {
-    char f_face = cube_.GetMappedFaceChar(F);
-    char l_face = cube_.GetMappedFaceChar(L);
-    char d_face = cube_.GetMappedFaceChar(D);
-    int face_tag = (1 << CvtFaceCharToFace(f_face)) |
-                   (1 << CvtFaceCharToFace(l_face)) |
-                   (1 << CvtFaceCharToFace(d_face));
-
-    char f_corner = cube_.GetPieceChar(F, 2, 0, false);
-    char l_corner = cube_.GetPieceChar(L, 2, 2, false);
-    char d_corner = cube_.GetPieceChar(D, 0, 0, false);
-    int corner_tag = (1 << CvtFaceCharToFace(f_corner)) |
-                   (1 << CvtFaceCharToFace(l_corner)) |
-                   (1 << CvtFaceCharToFace(d_corner));
+inline bool RubikCube3BasicSolver::IsDownCornerMatched(const int& corner/* = 0*/) {
+    int face_tag = 0;
+    int corner_tag = 0;
+    for (int i = 0; i < 3; i ++) {
+        const int (&p)[3] = down_corner_pieces[corner][i];
+        face_tag |= 1 << p[0];
+        corner_tag |= 1 << cube_.GetPieceFace((CUBE_FACE)p[0], p[1], p[2]);
+    }
 
     return (face_tag == corner_tag);
 }
@@ -391,12 +389,9 @@ inline bool RubikCube3BasicSolver::IsDownCornerMatched() {
 
 inline int RubikCube3BasicSolver::GetDownCornerMatchCount() {
     int match_count = 0;
-    for (int i = 0; i < 4; i ++) {
-        if (IsDownCornerMatched())
+    for (int i = 0; i < 4; i ++)
+        if (IsDownCornerMatched(i))
             match_count ++;
-
-        cube_.RotateCube(ROTATE);
-    }
     return match_count;
 }
 
@@ -407,22 +402,25 @@ bool RubikCube3BasicSolver::IsDownCornersSolved() {
 
 
 std::string RubikCube3BasicSolver::SolveDownCorners() {
+    RB_TRACE_SCOPE("BasicSolver::SolveDownCorners");
     std::string moves;
     const char d_face = cube_.GetMappedFaceChar(D);
 
     // Solve DOWN face corners permutation
     while (GetDownCornerMatchCount() < 4) {
+        RB_TRACE_SCOPE("Permute down corners");
         for (int i = 0; i < 3; i ++) {
             if (IsDownCornerMatched())
                 break;
             cube_.RotateCube(ROTATE);
         }
-        //std::cout << "Change corners positions on 3rd layer" << std::endl;
+        RB_TRACE_INSTANT("Change corners positions on 3rd layer");
         moves += MoveCube("D L D' R' D L' D' R");
     }
 
     // Solve DOWN face corners orientation
     while (!IsCornerOriented(D)) {
+        RB_TRACE_SCOPE("Orient down corner");
         for (int i = 0; i < 3; i ++) {
             if (cube_.GetPieceChar(D, 0, 0, false) != d_face)
                 break;
@@ -441,62 +439,103 @@ std::string RubikCube3BasicSolver::SolveDownCorners() {
 }
 
 
+// Orientations FindBestCubeOrientation starts from, one per up face. The stage checks
+// only compare pieces with the centers around them, so turning the cube about the up
+// axis never changes them, and the other 18 of the 24 orientations needn't be tried.
+static const int orientation_num = 6;
+// Orientations are scored by the stages done, then by the progress of the next stage
+static const int orientation_score_scale = 64;
+
+// Facelet remaps of the orientations, and the cube rotations which turn into them.
+// ROTATE turns the cube like y, and ROLL like x'.
+struct OrientationTables {
+    OrientationTables() {
+        static const ROTATE_CUBE_DIR rotations[orientation_num][4] = {
+            {}, {ROLL}, {ROLL, ROLL}, {ROLL, ROLL, ROLL}, {ROTATE, ROLL}, {ROTATE, ROLL, ROLL, ROLL}
+        };
+        static const int rotation_nums[orientation_num] = {0, 1, 2, 3, 2, 4};
+
+        for (int i = 0; i < orientation_num; i ++) {
+            perms[i] = RubikCubePermutation(3);
+            rotation_num[i] = rotation_nums[i];
+            for (int j = 0; j < rotation_nums[i]; j ++) {
+                orient_rotations[i][j] = rotations[i][j];
+                perms[i].Move((rotations[i][j] == ROTATE)? "y": "x'");
+            }
+        }
+    }
+
+    RubikCubePermutation perms[orientation_num];
+    ROTATE_CUBE_DIR orient_rotations[orientation_num][4];
+    int rotation_num[orientation_num];
+};
+
+
+// How far the stages of the solver are done in an oriented cube, the same chain of
+// checks as the solver makes, from the facelets alone
+static int GetOrientationScore(const char* colors) {
+    int face_of_colors[256];
+    for (int f = 0; f < UNKNOWN_FACE; f ++)
+        face_of_colors[(unsigned char)colors[f * 9 + 4]] = f;
+
+    uint64_t mask = 0;
+    for (int i = 0; i < UNKNOWN_FACE * 9; i ++)
+        mask |= (uint64_t)(colors[i] == colors[(i / 9) * 9 + 4]) << i;
+
+    const PieceCoord &up_edge = edge_pieces[UE], &down_edge = edge_pieces[DE];
+    const uint64_t stage_masks[8] = {
+        face_edges_mask << (U * 9),
+        GetSideFacesMask(up_edge.row, up_edge.col),
+        (face_corners_mask << (U * 9)) | GetSideFacesMask(0, 0),
+        GetSideFacesMask(1, 0) | GetSideFacesMask(1, 2),
+        face_edges_mask << (D * 9),
+        GetSideFacesMask(down_edge.row, down_edge.col),
+        0,
+        face_corners_mask << (D * 9)
+    };
+
+    // Pieces of the down corners in place, whatever their twist
+    int down_corner_num = 0;
+    for (int corner = 0; corner < 4; corner ++) {
+        int face_tag = 0, corner_tag = 0;
+        for (int i = 0; i < 3; i ++) {
+            const int (&p)[3] = down_corner_pieces[corner][i];
+            face_tag |= 1 << p[0];
+            corner_tag |= 1 << face_of_colors[(unsigned char)colors[(p[0] * 3 + p[1]) * 3 + p[2]]];
+        }
+        down_corner_num += (face_tag == corner_tag);
+    }
+
+    // Stages done, then the facelets already in place of the first stage left,
+    // which leave the solver less to do
+    int stage = 0;
+    while (stage < 8 && ((stage == 6)? down_corner_num == 4: (mask & stage_masks[stage]) == stage_masks[stage]))
+        stage ++;
+    if (stage == 8)
+        return stage * orientation_score_scale;
+    const int stage_progress = (stage == 6)? down_corner_num: __builtin_popcountll(mask & stage_masks[stage]);
+    return stage * orientation_score_scale + stage_progress;
+}
+
+
 void RubikCube3BasicSolver::FindBestCubeOrientation() {
+    RB_TRACE_SCOPE("BasicSolver::FindBestCubeOrientation");
+    static const OrientationTables tables;
+    const std::string colors = cube_.GetCubeString();
+    char oriented_colors[UNKNOWN_FACE * 9];
+
+    // Score every orientation from the facelets in one pass, then turn the cube once
     int max_score = 0;
     int max_orient_idx = 0;
-
-    // Find the best orientation to start solving the cube
-    for (int i = 0; i < 6; i ++) {
-        int score = 0;
-        if (IsCrossOriented(U)) {
-            score ++;
-            if (GetCrossMatchCount(UE) == 4) {
-                score ++;
-                if (IsUpCornersSolved()) {
-                    score ++;
-                    if (IsSecondLayerSolved()) {
-                        score ++;
-                        if (IsCrossOriented(D)) {
-                            score ++;
-                            if (GetCrossMatchCount(DE) == 4) {
-                                score ++;
-                                if (GetDownCornerMatchCount() == 4) {
-                                    score ++;
-                                    if (IsCornerOriented(D)) {
-                                        score ++;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    for (int i = 0; i < orientation_num; i ++) {
+        tables.perms[i].Apply(colors.c_str(), oriented_colors);
+        const int score = GetOrientationScore(oriented_colors);
         if (score > max_score) {
             max_score = score;
             max_orient_idx = i;
         }
-
-        cube_.RotateCube(ROLL);
-        if (i == 3) {
-            cube_.RotateCube(ROTATE);
-            cube_.RotateCube(ROLL);
-        } else if (i == 4) {
-            cube_.RotateCube(ROLL);
-        }
-    }
-    cube_.RotateCube(ROTATE);
-    cube_.RotateCube(ROTATE);
-    cube_.RotateCube(ROTATE);
-    assert(cube_.GetMappedFaceChar(U) == 'U');
-
-    for (int i = 0; i < max_orient_idx; i ++) {
-        cube_.RotateCube(ROLL);
-        if (i == 3) {
-            cube_.RotateCube(ROTATE);
-            cube_.RotateCube(ROLL);
-        } else if (i == 4) {
-            cube_.RotateCube(ROLL);
-        }
     }
-}
\ No newline at end of file
+
+    for (int i = 0; i < tables.rotation_num[max_orient_idx]; i ++)
+        cube_.RotateCube(tables.orient_rotations[max_orient_idx][i]);
+}
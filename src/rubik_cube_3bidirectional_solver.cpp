@@ -0,0 +1,382 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_3cubie.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <cassert>
+
+using namespace rb;
+
+static const int max_search_depth = 20;         // every cube is solvable in 20 face turns
+static const int max_solved_depth = 8;           // 1.5G states, past any sensible budget
+static const double branching_factor = 13.35;   // new states per state of a layer, past the first
+static const double max_load = 0.8;
+
+static const int opposite_faces[UNKNOWN_FACE] = {D, R, B, L, F, U};
+static const int location_bits = 5;
+static const uint64_t location_mask = (1 << location_bits) - 1;
+static const int depth_shift = 60;
+static const uint64_t edges_mask = (1ULL << depth_shift) - 1;
+static const uint32_t empty_corners = 0xffffffff;
+
+
+// A state as the location of every piece but the last corner and the last edge, which
+// go where the others aren't: pos * 3 + twist for corners, pos * 2 + flip for edges,
+// 5 bits each. edges holds edges 0 to 10 and corner 6, then the state's distance in
+// its top bits; corners holds corners 0 to 5.
+#pragma pack(push, 4)
+struct StateKey {
+    uint64_t edges;
+    uint32_t corners;
+};
+#pragma pack(pop)
+
+
+// Location of every piece after each face turn, by its location before
+struct LocationMoves {
+    LocationMoves() {
+        for (int m = 0; m < face_move_num; m ++) {
+            const RubikCube3Cubie &move = RubikCube3Cubie::GetMoveCubie(m);
+            for (int i = 0; i < CORNER_NUM; i ++)
+                for (int ori = 0; ori < 3; ori ++)
+                    corners[m][move.cp[i] * 3 + ori] = i * 3 + (ori + move.co[i]) % 3;
+            for (int i = 0; i < EDGE_NUM; i ++)
+                for (int ori = 0; ori < 2; ori ++)
+                    edges[m][move.ep[i] * 2 + ori] = i * 2 + (ori ^ move.eo[i]);
+        }
+    }
+
+    unsigned char corners[face_move_num][1 << location_bits];
+    unsigned char edges[face_move_num][1 << location_bits];
+};
+
+
+static const LocationMoves& GetLocationMoves() {
+    static const LocationMoves moves;
+    return moves;
+}
+
+
+static void SetStateKey(const RubikCube3Cubie& cubie, StateKey& key) {
+    unsigned char corner_locations[CORNER_NUM], edge_locations[EDGE_NUM];
+    for (int i = 0; i < CORNER_NUM; i ++)
+        corner_locations[cubie.cp[i]] = i * 3 + cubie.co[i];
+    for (int i = 0; i < EDGE_NUM; i ++)
+        edge_locations[cubie.ep[i]] = i * 2 + cubie.eo[i];
+
+    key.corners = 0;
+    for (int i = 0; i < CORNER_NUM - 2; i ++)
+        key.corners |= (uint32_t)corner_locations[i] << (i * location_bits);
+    key.edges = (uint64_t)corner_locations[CORNER_NUM - 2] << ((EDGE_NUM - 1) * location_bits);
+    for (int i = 0; i < EDGE_NUM - 1; i ++)
+        key.edges |= (uint64_t)edge_locations[i] << (i * location_bits);
+}
+
+
+// next gets the state after move m, without a distance
+static inline void MoveState(const LocationMoves& moves, const StateKey& key, const int& m, StateKey& next) {
+    const unsigned char *corner_moves = moves.corners[m];
+    const unsigned char *edge_moves = moves.edges[m];
+    uint32_t corners = 0;
+    for (int shift = 0; shift < (CORNER_NUM - 2) * location_bits; shift += location_bits)
+        corners |= (uint32_t)corner_moves[(key.corners >> shift) & location_mask] << shift;
+    uint64_t edges = 0;
+    for (int shift = 0; shift < (EDGE_NUM - 1) * location_bits; shift += location_bits)
+        edges |= (uint64_t)edge_moves[(key.edges >> shift) & location_mask] << shift;
+    edges |= (uint64_t)corner_moves[(key.edges >> ((EDGE_NUM - 1) * location_bits)) & location_mask]
+             << ((EDGE_NUM - 1) * location_bits);
+    next.corners = corners;
+    next.edges = edges;
+}
+
+
+// Open addressing hash set of states with their distances, kept at most max_load full
+class StateTable {
+  public:
+    StateTable(): entry_num_(0) {}
+
+    static uint64_t GetMemory(const double& state_num) {
+        return (uint64_t)(state_num / max_load + 1) * sizeof(StateKey);
+    }
+    uint64_t GetMemory() const { return entries_.capacity() * sizeof(StateKey); }
+    size_t GetSize() const { return entries_.size(); }
+    size_t GetStateNum() const { return entry_num_; }
+    // Slot i's state and its distance, -1 if the slot is empty
+    const StateKey& GetEntry(const size_t& i) const { return entries_[i]; }
+    int GetDepth(const size_t& i) const {
+        return (entries_[i].corners == empty_corners)? -1: (int)(entries_[i].edges >> depth_shift);
+    }
+
+    // Make room for state_num states in all, so that they are put without rehashing
+    void Reserve(const double& state_num) {
+        const size_t size = (size_t)(state_num / max_load + 1);
+        if (size <= entries_.size())
+            return;
+        std::vector<StateKey> old_entries(size);
+        old_entries.swap(entries_);
+        for (size_t i = 0; i < entries_.size(); i ++)
+            entries_[i].corners = empty_corners;
+        for (size_t i = 0; i < old_entries.size(); i ++)
+            if (old_entries[i].corners != empty_corners)
+                Put(old_entries[i]);
+    }
+
+    // Distance of the state, -1 if it isn't in the table
+    int Find(const StateKey& key) const {
+        if (entries_.empty())
+            return -1;
+        for (size_t i = GetSlot(key); ; i = (i + 1 < entries_.size())? i + 1: 0) {
+            const StateKey &entry = entries_[i];
+            if (entry.corners == empty_corners)
+                return -1;
+            if (IsEqual(entry, key))
+                return (int)(entry.edges >> depth_shift);
+        }
+    }
+
+    // Returns false if the state is already in the table. The table grows past the
+    // reserved size only when more states than reserved are put.
+    bool Insert(const StateKey& key, const int& depth) {
+        if (entry_num_ + 1 > entries_.size() * max_load)
+            Reserve(std::max(1024.0, entries_.size() * 2 * max_load));
+        size_t i = GetSlot(key);
+        for (; entries_[i].corners != empty_corners; i = (i + 1 < entries_.size())? i + 1: 0)
+            if (IsEqual(entries_[i], key))
+                return false;
+        entries_[i].corners = key.corners;
+        entries_[i].edges = (key.edges & edges_mask) | ((uint64_t)depth << depth_shift);
+        entry_num_ ++;
+        return true;
+    }
+
+  private:
+    static bool IsEqual(const StateKey& entry, const StateKey& key) {
+        return entry.corners == key.corners && ((entry.edges ^ key.edges) & edges_mask) == 0;
+    }
+
+    size_t GetSlot(const StateKey& key) const {
+        const uint64_t hash = ((key.edges & edges_mask) * 0x9e3779b97f4a7c15ULL) ^ (key.corners * 0xc2b2ae3d27d4eb4fULL);
+        return ((hash >> 32) * entries_.size()) >> 32;
+    }
+
+    void Put(const StateKey& entry) {
+        size_t i = GetSlot(entry);
+        while (entries_[i].corners != empty_corners)
+            i = (i + 1 < entries_.size())? i + 1: 0;
+        entries_[i] = entry;
+    }
+
+    std::vector<StateKey> entries_;
+    size_t entry_num_;
+};
+
+
+// States within depth moves of one, when every layer but the first grows by branching_factor
+static double GetPredictedStateNum(const int& depth) {
+    double state_num = 1, layer_num = face_move_num;
+    for (int d = 1; d <= depth; d ++, layer_num *= branching_factor)
+        state_num += layer_num;
+    return state_num;
+}
+
+
+// Deepest search from the solved state whose table takes at most half of max_memory,
+// leaving the other half to the search from the cube
+static int GetSolvedDepth(const uint64_t& max_memory) {
+    int depth = 0;
+    while (depth < max_solved_depth && StateTable::GetMemory(GetPredictedStateNum(depth + 1)) <= max_memory / 2)
+        depth ++;
+    return depth;
+}
+
+
+static std::mutex solved_table_mutex;
+static std::unique_ptr<StateTable> solved_tables[max_solved_depth + 1];
+
+
+// Every state within depth moves of the solved state, built on first use and shared by
+// all the solvers of the process
+static const StateTable& GetSolvedTable(const int& depth) {
+    std::lock_guard<std::mutex> lock(solved_table_mutex);
+    if (solved_tables[depth])
+        return *solved_tables[depth];
+
+    const LocationMoves &location_moves = GetLocationMoves();
+    std::unique_ptr<StateTable> table(new StateTable());
+    table->Reserve(GetPredictedStateNum(depth));
+    StateKey key;
+    SetStateKey(RubikCube3Cubie(), key);
+    table->Insert(key, 0);
+
+    // Layers are expanded from the table itself, which needs no frontier as large as the
+    // last layer. If the table grows, its states move, so the layer is scanned again.
+    for (int d = 0; d < depth; d ++) {
+        size_t size;
+        do {
+            size = table->GetSize();
+            for (size_t i = 0; i < size && table->GetSize() == size; i ++) {
+                if (table->GetDepth(i) != d)
+                    continue;
+                const StateKey parent = table->GetEntry(i);
+                for (int m = 0; m < face_move_num; m ++) {
+                    MoveState(location_moves, parent, m, key);
+                    table->Insert(key, d + 1);
+                }
+            }
+        } while (table->GetSize() != size);
+    }
+
+    solved_tables[depth].swap(table);
+    return *solved_tables[depth];
+}
+
+
+struct FrontierState {
+    StateKey key;
+    MinMoveCoords coords;
+    int last_face;
+};
+
+
+std::string RubikCube3BidirectionalSolver::DoSolve() {
+    is_fallen_back_ = false;
+
+    RubikCube3Cubie start(cube_);
+    if (start.IsSolved())
+        return "";
+
+    const int solved_depth = GetSolvedDepth(max_memory_);
+    const StateTable &solved_table = GetSolvedTable(solved_depth);
+    const LocationMoves &location_moves = GetLocationMoves();
+
+    // Deepest layer the search from the cube could reach in the memory left, so states
+    // too far from the solved state to be within solved_depth of it by then are dropped
+    int max_depth = 0;
+    while (solved_depth + max_depth < max_search_depth) {
+        const double state_num = GetPredictedStateNum(max_depth + 1);
+        if (solved_table.GetMemory() + StateTable::GetMemory(state_num) + state_num * sizeof(FrontierState) > max_memory_)
+            break;
+        max_depth ++;
+    }
+    const int max_length = solved_depth + max_depth;
+
+    // Search from the cube a layer at a time, for a state within solved_depth moves of
+    // the solved state. None of the layers before was, so the first one found is on an
+    // optimal solution.
+    StateTable table;
+    std::vector<FrontierState> frontier(1), next;
+    SetStateKey(start, frontier[0].key);
+    GetMinMoveCoords(start, frontier[0].coords);
+    frontier[0].last_face = -1;
+    if (GetMinMoveNum(frontier[0].coords) > max_length)
+        return Fallback();
+    table.Insert(frontier[0].key, 0);
+    StateKey meet_key = frontier[0].key;
+    int depth = 0;
+    uint64_t node_num = 0;
+    while (solved_table.Find(meet_key) < 0) {
+        if (depth == max_depth || frontier.empty())
+            return Fallback();
+
+        // Fall back before expanding a layer which wouldn't fit in the memory left, or
+        // would take the search past max_node_num_ states
+        const double next_num = (depth == 0)? face_move_num: frontier.size() * branching_factor;
+        const uint64_t memory = solved_table.GetMemory() + StateTable::GetMemory(table.GetStateNum() + next_num) +
+                                (uint64_t)((frontier.size() + next_num) * sizeof(FrontierState));
+        if (memory > max_memory_ || node_num + next_num > max_node_num_)
+            return Fallback();
+        table.Reserve(table.GetStateNum() + next_num);
+        next.clear();
+        next.reserve((size_t)next_num);
+
+        bool is_met = false;
+        for (size_t i = 0; i < frontier.size() && !is_met; i ++) {
+            const FrontierState &parent = frontier[i];
+            for (int m = 0; m < face_move_num; m ++) {
+                // Skip turning the same face twice, and one order of opposite faces
+                const int face = m / 3;
+                if (face == parent.last_face ||
+                    (parent.last_face >= 0 && face == opposite_faces[parent.last_face] && face < parent.last_face))
+                    continue;
+
+                node_num ++;
+                FrontierState child;
+                MoveMinMoveCoords(parent.coords, m, child.coords);
+                const int min_move_num = GetMinMoveNum(child.coords);
+                if (depth + 1 + min_move_num > max_length)
+                    continue;
+                MoveState(location_moves, parent.key, m, child.key);
+                // The last layer isn't expanded, so its states are only looked up
+                if (depth + 1 < max_depth && !table.Insert(child.key, depth + 1))
+                    continue;
+                if (min_move_num <= solved_depth && solved_table.Find(child.key) >= 0) {
+                    meet_key = child.key;
+                    is_met = true;
+                    break;
+                }
+                if (depth + 1 < max_depth) {
+                    child.last_face = face;
+                    next.push_back(child);
+                }
+            }
+        }
+        frontier.swap(next);
+        depth ++;
+    }
+
+    // Moves back from the meeting state to the cube, then on from it to the solved state
+    std::vector<int> path;
+    StateKey key = meet_key, next_key;
+    for (int d = depth; d > 0; d --)
+        for (int m = 0; m < face_move_num; m ++) {
+            MoveState(location_moves, key, m, next_key);
+            if (table.Find(next_key) == d - 1) {
+                path.push_back((m / 3) * 3 + (2 - m % 3));
+                key = next_key;
+                break;
+            }
+        }
+    std::reverse(path.begin(), path.end());
+    key = meet_key;
+    for (int d = solved_table.Find(key); d > 0; d --)
+        for (int m = 0; m < face_move_num; m ++) {
+            MoveState(location_moves, key, m, next_key);
+            if (solved_table.Find(next_key) == d - 1) {
+                path.push_back(m);
+                key = next_key;
+                break;
+            }
+        }
+
+    std::string moves;
+    for (int i = 0; i < path.size(); i ++)
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(path[i]));
+    return cube_.CompressMoves(moves);
+}
+
+
+std::string RubikCube3BidirectionalSolver::Fallback() {
+    is_fallen_back_ = true;
+    if (!fallback_) {
+        if (!default_fallback_)
+            default_fallback_.reset(new RubikCube3ThistlethwaiteSolver());
+        fallback_ = default_fallback_.get();
+    }
+    return fallback_->Solve(cube_);
+}
@@ -0,0 +1,648 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_3cubie.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+using namespace rb;
+
+static const unsigned char unknown_cost = 0xff;
+
+// Cross case: (position * 2 + orientation) of DR, DF, DL and DB edges
+static const int cross_case_num = 24 * 24 * 24 * 24;
+// F2L pair case: (position * 3 + orientation) of the corner x (position * 2 + orientation) of the edge
+static const int pair_case_num = 24 * 24;
+// OLL case: orientations of the 4 up corners (base 3) x orientations of the 4 up edges (base 2)
+static const int oll_case_num = 81 * 16;
+// PLL case: permutation rank of the 4 up corners x permutation rank of the 4 up edges
+static const int pll_case_num = 24 * 24;
+
+static const int f2l_slot_num = 4;
+static const int f2l_mask_num = 1 << (f2l_slot_num - 1);
+
+// Corner and edge of F2L slots FR, FL, BL and BR
+static const int f2l_slot_pieces[f2l_slot_num][2] = {
+    {DFR, FR}, {DLF, FL}, {DBL, BL}, {DRB, BR}
+};
+
+// Each slot is worked by "X U* X'" macros, which keep the cross and the other slots
+static const char* f2l_slot_moves[f2l_slot_num][2][2] = {
+    {{"R",  "R'"}, {"F'", "F" }},   // FR
+    {{"L'", "L" }, {"F",  "F'"}},   // FL
+    {{"L",  "L'"}, {"B'", "B" }},   // BL
+    {{"R'", "R" }, {"B",  "B'"}},   // BR
+};
+
+static const char* up_turns[3] = {"U", "U2", "U'"};
+
+// An algorithm for each of the 57 OLL cases, keeping the first two layers. Cases which
+// are only known by wide or slice turn algorithms take the shortest face turn sequence
+// of two algorithms instead, as the cubie model turns faces only.
+static const char* oll_algorithms[] = {
+    "R U R' U R U2 R'",
+    "R U2 R' U' R U' R'",
+    "F R U R' U' F'",
+    "F U R U' R' F'",
+    "R U R' U' R' F R F'",
+    "F R U R' U' R U R' U' F'",
+    "R U2 R2 U' R2 U' R2 U2 R",
+    "R U R' U R U' R' U R U2 R'",
+    "R U R' U R U2 R' F R U R' U' F'",
+    "F R U R' U' F' U F R U R' U' F'",
+    "R' F R U R' U' F' U R",
+    "F R' F' R U R U' R'",
+    "R U2 R' U2 R' F R F'",
+    "R2 D R' U2 R D' R' U2 R'",
+    "R U2 R2 F R F' R U2 R'",
+    "R' U' F' U F R",
+    "R U R2 U' R' F R U R U' F'",
+    "R U B' U' R' U R B R'",
+    "R' U' R' F R F' U R",
+    "R' U' F U R U' R' F' R",
+    "L' U' L U' L' U L U L F' L' F",
+    "R2 U R' B' R U' R2 U R B R'",
+    "R U R' U R U' R' U' R' F R F'",
+    "F U R U2 R' U' R U R' F'",
+    "R' F R' F' R2 U2 B' R B R'",
+    "R U2 R2 F R F' U2 R' F R F'",
+    "L F R' F' L' F R F'",
+    "R' F R B' R' F' R B",
+    "F U R U' R' U R U' R' F'",
+    "R U R' U R U' B U' B' R'",
+    "R' F R U R U' R2 F' R2 U' R' U R U R'",
+    "F' L' U' L U L' U' L U F",
+    "L F' L' U' L U F U' L'",
+    "R' U' R U' R' U2 R F R U R' U' F'",
+    "R' F R U R' F' R F U' F'",
+    "R U R' U R' F R F' U2 R' F R F'",
+    "L F R' F' L' R U R U' R'",
+    "R' U' F' U F R U2 R' U' F' U F R",
+    "R' U' F' U F R U R' U' R' F R F' U R",
+    "L2 U' L B L' U L2 U' L' B' L",
+    "R' U' F' U F2 R U R' U' F' U R",
+    "F R' F' R U2 F R' F' R U' R U' R'",
+    "F R U' R' U R U2 R' U' F'",
+    "R' U' F' U F R F U R U' R' F'",
+    "F' U' F L F' L' U L F L'",
+    "R' U' F' U F R U2 F R U R' U' F'",
+    "F' L' U L U' L' U2 L U F",
+    "F U R U' R' F' R' U' F' U F R",
+    "F' L' U' L U F U' F' L' U' L U F",
+    "L' U2 L U2 L F' L' F",
+    "F U F' R' F R U' R' F' R",
+    "R' U' F' U F R F R U R' U' F'",
+    "L F' L F L2 U2 B L' B' L",
+    "F R' F' R U2 F R' F' R2 U2 R'",
+    "L' B L B' U2 L2 F' L' F L'",
+    "F R U R' U' F' L F R' F' L' F R F'",
+    "R B' R' B U2 R2 F R F' R",
+};
+
+// An algorithm for each of the 21 PLL cases, keeping the first two layers and
+// the last layer orientation
+static const char* pll_algorithms[] = {
+    "R U R' U' R' F R2 U' R' U' R U R' F'",
+    "R U' R U R U R U' R' U' R2",
+    "R2 U R U R' U' R' U' R' U R'",
+    "R' F R' B2 R F' R' B2 R2",
+    "R2 B2 R F R' B2 R F' R",
+    "R2 U2 R U2 R2 U2 R2 U2 R U2 R2",
+    "F R U' R' U' R U R' F' R U R' U' R' F R F'",
+    "R' U L' U2 R U' R' U2 R L",
+    "L U2 L' U2 L F' L' U' L U L F L2",
+    "R' U2 R U2 R' F R U R' U' R' F' R2",
+    "R' U R U' R2 F' U' F U R F R' F' R2",
+    "R2 U R' U R' U' R U' R2 D U' R' U R D'",
+    "R' U' R U D' R2 U R' U R U' R U' R2 D",
+    "R2 U' R U' R U R' U R2 D' U R U' R' D",
+    "R U R' U' D R2 U' R U' R' U R' U R2 D'",
+    "R' U R U' R' F' U' F R U R' F R' F' R U' R",
+    "R' U R' U' R D' R' D R' U D' R2 U' R2 D R2",
+    "R' U' R U' R U R U' R' U R U R2 U' R'",
+    "R' U L' D2 L U' R L' U R' D2 R U' L",
+    "L U' R U2 L' U L U2 L' R'",
+    "L U' L' U L F U F' L' U' L F' L F L' U L'",
+};
+
+
+struct Macro {
+    std::string moves;
+    RubikCube3Cubie cubie;
+    int cost;
+};
+
+// Cost to solve every case and the first macro to apply,
+// indexed by the case index.
+struct CaseTable {
+    std::vector<unsigned char> cost;
+    std::vector<unsigned char> macro;
+};
+
+struct CFOPTables {
+    CFOPTables();
+
+    std::vector<unsigned char> cross_dist;
+    int edge_moves[face_move_num][24];
+
+    std::vector<Macro> f2l_macros;
+    CaseTable f2l_tables[f2l_mask_num];
+
+    std::vector<Macro> oll_macros;
+    CaseTable oll_table;
+
+    std::vector<Macro> pll_macros;
+    CaseTable pll_table;
+};
+
+
+static Macro CompileMacro(const std::string& moves) {
+    Macro macro;
+    macro.moves = moves;
+    macro.cubie.Move(moves);
+    macro.cost = 0;
+    for (int i = 0; i < moves.length(); i ++)
+        if (CvtFaceCharToFace(moves[i]) != UNKNOWN_FACE)
+            macro.cost ++;
+    return macro;
+}
+
+
+static bool IsF2LKept(const RubikCube3Cubie& cubie) {
+    for (int i = DFR; i < CORNER_NUM; i ++)
+        if (cubie.cp[i] != i || cubie.co[i] != 0)
+            return false;
+    for (int i = DR; i < EDGE_NUM; i ++)
+        if (cubie.ep[i] != i || cubie.eo[i] != 0)
+            return false;
+    return true;
+}
+
+
+// Relax macro transitions until no case cost improves, which gives
+// the cheapest macro sequence from every reachable case to the solved case.
+static void BuildCaseTable(CaseTable& table, const int& case_num, const int& solved_case,
+                           const std::vector<Macro>& macros,
+                           const std::vector<std::vector<int> >& next_cases,
+                           const std::vector<int>& macro_idxs) {
+    table.cost.assign(case_num, unknown_cost);
+    table.macro.assign(case_num, 0);
+    table.cost[solved_case] = 0;
+
+    bool updated = true;
+    while (updated) {
+        updated = false;
+        for (int c = 0; c < case_num; c ++) {
+            for (int i = 0; i < macro_idxs.size(); i ++) {
+                int m = macro_idxs[i];
+                int next_case = next_cases[m][c];
+                if (next_case < 0 || table.cost[next_case] == unknown_cost)
+                    continue;
+                int cost = table.cost[next_case] + macros[m].cost;
+                if (cost < table.cost[c]) {
+                    table.cost[c] = cost;
+                    table.macro[c] = m;
+                    updated = true;
+                }
+            }
+        }
+    }
+}
+
+
+// Give every case which has no cost yet the cheapest single macro to a case the table
+// already solves. Unlike BuildCaseTable, macros aren't chained, so a case is solved by
+// one algorithm and the turns of U around it.
+static void AddCaseMacros(CaseTable& table, const std::vector<Macro>& macros,
+                          const std::vector<std::vector<int> >& next_cases,
+                          const std::vector<int>& macro_idxs) {
+    const std::vector<unsigned char> prev_cost = table.cost;
+    for (int c = 0; c < prev_cost.size(); c ++) {
+        if (prev_cost[c] != unknown_cost)
+            continue;
+        for (int i = 0; i < macro_idxs.size(); i ++) {
+            int m = macro_idxs[i];
+            int next_case = next_cases[m][c];
+            if (next_case < 0 || prev_cost[next_case] == unknown_cost)
+                continue;
+            int cost = prev_cost[next_case] + macros[m].cost;
+            if (cost < table.cost[c]) {
+                table.cost[c] = cost;
+                table.macro[c] = m;
+            }
+        }
+    }
+}
+
+
+inline int GetPermRank(const int* perm) {
+    int rank = 0;
+    for (int i = 0; i < 4; i ++) {
+        int less_cnt = 0;
+        for (int j = i + 1; j < 4; j ++)
+            if (perm[j] < perm[i])
+                less_cnt ++;
+        rank = rank * (4 - i) + less_cnt;
+    }
+    return rank;
+}
+
+
+inline int GetCornerState(const RubikCube3Cubie& cubie, const int& corner) {
+    for (int i = 0; i < CORNER_NUM; i ++)
+        if (cubie.cp[i] == corner)
+            return i * 3 + cubie.co[i];
+    assert(0);
+    return -1;
+}
+
+
+inline int GetEdgeState(const RubikCube3Cubie& cubie, const int& edge) {
+    for (int i = 0; i < EDGE_NUM; i ++)
+        if (cubie.ep[i] == edge)
+            return i * 2 + cubie.eo[i];
+    assert(0);
+    return -1;
+}
+
+
+inline int GetCornerStateAfter(const RubikCube3Cubie& move, const int& state) {
+    for (int i = 0; i < CORNER_NUM; i ++)
+        if (move.cp[i] == state / 3)
+            return i * 3 + (state % 3 + move.co[i]) % 3;
+    assert(0);
+    return -1;
+}
+
+
+inline int GetEdgeStateAfter(const RubikCube3Cubie& move, const int& state) {
+    for (int i = 0; i < EDGE_NUM; i ++)
+        if (move.ep[i] == state / 2)
+            return i * 2 + ((state % 2) ^ move.eo[i]);
+    assert(0);
+    return -1;
+}
+
+
+inline int GetCrossCase(const RubikCube3Cubie& cubie) {
+    int cross_case = 0;
+    for (int e = DR; e <= DB; e ++)
+        cross_case = cross_case * 24 + GetEdgeState(cubie, e);
+    return cross_case;
+}
+
+
+inline int GetCrossCaseAfter(const CFOPTables& tables, const int& cross_case, const int& move_idx) {
+    int next_case = 0;
+    for (int shift = 24 * 24 * 24; shift > 0; shift /= 24)
+        next_case = next_case * 24 + tables.edge_moves[move_idx][(cross_case / shift) % 24];
+    return next_case;
+}
+
+
+inline int GetPairCase(const RubikCube3Cubie& cubie) {
+    return GetCornerState(cubie, DFR) * 24 + GetEdgeState(cubie, FR);
+}
+
+
+inline int GetOLLCase(const RubikCube3Cubie& cubie) {
+    int oll_case = 0;
+    for (int i = URF; i <= UBR; i ++)
+        oll_case = oll_case * 3 + cubie.co[i];
+    for (int i = UR; i <= UB; i ++)
+        oll_case = oll_case * 2 + cubie.eo[i];
+    return oll_case;
+}
+
+
+inline int GetPLLCase(const RubikCube3Cubie& cubie) {
+    int corner_perm[4], edge_perm[4];
+    for (int i = 0; i < 4; i ++) {
+        corner_perm[i] = cubie.cp[URF + i];
+        edge_perm[i] = cubie.ep[UR + i];
+    }
+    return GetPermRank(corner_perm) * 24 + GetPermRank(edge_perm);
+}
+
+
+CFOPTables::CFOPTables() {
+    // Cross: exact distance of every cross case by breadth-first search
+    for (int m = 0; m < face_move_num; m ++)
+        for (int s = 0; s < 24; s ++)
+            edge_moves[m][s] = GetEdgeStateAfter(RubikCube3Cubie::GetMoveCubie(m), s);
+
+    cross_dist.assign(cross_case_num, unknown_cost);
+    std::vector<int> frontier(1, GetCrossCase(RubikCube3Cubie()));
+    cross_dist[frontier[0]] = 0;
+    for (int depth = 0; !frontier.empty(); depth ++) {
+        std::vector<int> next_frontier;
+        for (int i = 0; i < frontier.size(); i ++) {
+            for (int m = 0; m < face_move_num; m ++) {
+                int next_case = GetCrossCaseAfter(*this, frontier[i], m);
+                if (cross_dist[next_case] == unknown_cost) {
+                    cross_dist[next_case] = depth + 1;
+                    next_frontier.push_back(next_case);
+                }
+            }
+        }
+        frontier.swap(next_frontier);
+    }
+
+    // F2L: pair cases of the FR slot, one table for each combination of solved other slots
+    for (int t = 0; t < 3; t ++)
+        f2l_macros.push_back(CompileMacro(up_turns[t]));
+    for (int s = 0; s < f2l_slot_num; s ++)
+        for (int i = 0; i < 2; i ++)
+            for (int t = 0; t < 3; t ++)
+                f2l_macros.push_back(CompileMacro(std::string(f2l_slot_moves[s][i][0]) + " " +
+                                                  up_turns[t] + " " + f2l_slot_moves[s][i][1]));
+
+    std::vector<std::vector<int> > next_cases(f2l_macros.size(), std::vector<int>(pair_case_num));
+    for (int m = 0; m < f2l_macros.size(); m ++)
+        for (int c = 0; c < pair_case_num; c ++)
+            next_cases[m][c] = GetCornerStateAfter(f2l_macros[m].cubie, c / 24) * 24 +
+                               GetEdgeStateAfter(f2l_macros[m].cubie, c % 24);
+
+    const int pair_solved_case = (DFR * 3) * 24 + (FR * 2);
+    for (int mask = 0; mask < f2l_mask_num; mask ++) {
+        std::vector<int> macro_idxs;
+        for (int m = 0; m < f2l_macros.size(); m ++) {
+            int slot = (m < 3)? -1: (m - 3) / 6;
+            if (slot <= 0 || !(mask & (1 << (slot - 1))))
+                macro_idxs.push_back(m);
+        }
+        BuildCaseTable(f2l_tables[mask], pair_case_num, pair_solved_case,
+                       f2l_macros, next_cases, macro_idxs);
+    }
+
+    // OLL: orientation cases of the last layer, each solved by one algorithm after U is
+    // turned to the angle it's learnt at
+    for (int i = 0; i < sizeof(oll_algorithms) / sizeof(oll_algorithms[0]); i ++) {
+        for (int t = -1; t < 3; t ++) {
+            oll_macros.push_back(CompileMacro((t < 0)? oll_algorithms[i]: std::string(up_turns[t]) + " " + oll_algorithms[i]));
+            assert(IsF2LKept(oll_macros.back().cubie));
+        }
+    }
+
+    next_cases.assign(oll_macros.size(), std::vector<int>(oll_case_num));
+    std::vector<int> macro_idxs;
+    for (int m = 0; m < oll_macros.size(); m ++) {
+        const RubikCube3Cubie &move = oll_macros[m].cubie;
+        for (int c = 0; c < oll_case_num; c ++) {
+            int co[4], eo[4];
+            for (int i = 0, cc = c; i < 4; i ++, cc /= 2)
+                eo[3 - i] = cc % 2;
+            for (int i = 0, cc = c / 16; i < 4; i ++, cc /= 3)
+                co[3 - i] = cc % 3;
+
+            int next_case = 0;
+            for (int i = 0; i < 4; i ++)
+                next_case = next_case * 3 + (co[move.cp[URF + i]] + move.co[URF + i]) % 3;
+            for (int i = 0; i < 4; i ++)
+                next_case = next_case * 2 + (eo[move.ep[UR + i]] ^ move.eo[UR + i]);
+            next_cases[m][c] = next_case;
+        }
+        macro_idxs.push_back(m);
+    }
+    oll_table.cost.assign(oll_case_num, unknown_cost);
+    oll_table.macro.assign(oll_case_num, 0);
+    oll_table.cost[0] = 0;
+    AddCaseMacros(oll_table, oll_macros, next_cases, macro_idxs);
+
+    // PLL: permutation cases of the last layer, each solved by one algorithm with U
+    // turned before it, then U turned to place the layer
+    for (int t = 0; t < 3; t ++)
+        pll_macros.push_back(CompileMacro(up_turns[t]));
+    for (int i = 0; i < sizeof(pll_algorithms) / sizeof(pll_algorithms[0]); i ++) {
+        for (int t = -1; t < 3; t ++) {
+            pll_macros.push_back(CompileMacro((t < 0)? pll_algorithms[i]: std::string(up_turns[t]) + " " + pll_algorithms[i]));
+            assert(IsF2LKept(pll_macros.back().cubie) && GetOLLCase(pll_macros.back().cubie) == 0);
+        }
+    }
+
+    next_cases.assign(pll_macros.size(), std::vector<int>(pll_case_num, -1));
+    for (int m = 0; m < pll_macros.size(); m ++) {
+        const RubikCube3Cubie &move = pll_macros[m].cubie;
+        int corner_perm[4] = {0, 1, 2, 3};
+        do {
+            int edge_perm[4] = {0, 1, 2, 3};
+            do {
+                int next_corner_perm[4], next_edge_perm[4];
+                for (int i = 0; i < 4; i ++) {
+                    next_corner_perm[i] = corner_perm[move.cp[URF + i]];
+                    next_edge_perm[i] = edge_perm[move.ep[UR + i]];
+                }
+                next_cases[m][GetPermRank(corner_perm) * 24 + GetPermRank(edge_perm)] =
+                    GetPermRank(next_corner_perm) * 24 + GetPermRank(next_edge_perm);
+            } while (std::next_permutation(edge_perm, edge_perm + 4));
+        } while (std::next_permutation(corner_perm, corner_perm + 4));
+    }
+    pll_table.cost.assign(pll_case_num, unknown_cost);
+    pll_table.macro.assign(pll_case_num, 0);
+    pll_table.cost[0] = 0;
+    std::vector<int> auf_idxs, algorithm_idxs;
+    for (int m = 0; m < pll_macros.size(); m ++)
+        ((m < 3)? auf_idxs: algorithm_idxs).push_back(m);
+    AddCaseMacros(pll_table, pll_macros, next_cases, auf_idxs);
+    AddCaseMacros(pll_table, pll_macros, next_cases, algorithm_idxs);
+}
+
+
+static const CFOPTables& GetCFOPTables() {
+    static const CFOPTables tables;
+    return tables;
+}
+
+
+std::string RubikCube3CFOPSolver::DoSolve() {
+    std::string moves;
+
+    if (!IsCrossSolved())
+        moves += SolveCross() + " ";
+
+    if (!IsF2LSolved())
+        moves += SolveF2L() + " ";
+
+    if (!IsLastLayerOriented())
+        moves += SolveOLL() + " ";
+
+    if (!IsLastLayerPermuted())
+        moves += SolvePLL();
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Step 1: Down Cross
+bool RubikCube3CFOPSolver::IsCrossSolved() {
+    RubikCube3Cubie cubie(cube_);
+    for (int i = DR; i <= DB; i ++)
+        if (cubie.ep[i] != i || cubie.eo[i] != 0)
+            return false;
+    return true;
+}
+
+
+std::string RubikCube3CFOPSolver::SolveCross() {
+    const CFOPTables &tables = GetCFOPTables();
+    std::string moves;
+
+    // The distance table is exact, so following any move which
+    // decreases the distance gives an optimal cross.
+    int cross_case = GetCrossCase(RubikCube3Cubie(cube_));
+    while (tables.cross_dist[cross_case] > 0) {
+        int m = 0;
+        for (; m < face_move_num; m ++) {
+            int next_case = GetCrossCaseAfter(tables, cross_case, m);
+            if (tables.cross_dist[next_case] < tables.cross_dist[cross_case]) {
+                moves += MoveCube(RubikCube3Cubie::GetMoveString(m));
+                cross_case = next_case;
+                break;
+            }
+        }
+        CheckProgress(m < face_move_num, "CFOP cross");
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Step 2: First Two Layers
+inline int RubikCube3CFOPSolver::GetF2LSolvedMask() {
+    RubikCube3Cubie cubie(cube_);
+    int mask = 0;
+    for (int s = 1; s < f2l_slot_num; s ++) {
+        int corner = f2l_slot_pieces[s][0];
+        int edge = f2l_slot_pieces[s][1];
+        if (cubie.cp[corner] == corner && cubie.co[corner] == 0 &&
+            cubie.ep[edge] == edge && cubie.eo[edge] == 0)
+            mask |= 1 << (s - 1);
+    }
+    return mask;
+}
+
+
+inline int RubikCube3CFOPSolver::GetFrontRightPairCost() {
+    const CFOPTables &tables = GetCFOPTables();
+    return tables.f2l_tables[GetF2LSolvedMask()].cost[GetPairCase(RubikCube3Cubie(cube_))];
+}
+
+
+bool RubikCube3CFOPSolver::IsF2LSolved() {
+    RubikCube3Cubie cubie(cube_);
+    return IsF2LKept(cubie);
+}
+
+
+std::string RubikCube3CFOPSolver::SolveF2L() {
+    std::string moves;
+
+    while (!IsF2LSolved()) {
+        // Pick the unsolved slot with the cheapest pair case
+        int min_cost = unknown_cost;
+        int min_rotate_cnt = 0;
+        for (int i = 0; i < 4; i ++) {
+            int cost = GetFrontRightPairCost();
+            if (cost > 0 && cost < min_cost) {
+                min_cost = cost;
+                min_rotate_cnt = i;
+            }
+            cube_.RotateCube(ROTATE);
+        }
+        CheckProgress(min_cost != unknown_cost, "CFOP F2L");
+
+        for (int i = 0; i < min_rotate_cnt; i ++)
+            cube_.RotateCube(ROTATE);
+        moves += SolveFrontRightPair();
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+std::string RubikCube3CFOPSolver::SolveFrontRightPair() {
+    const CFOPTables &tables = GetCFOPTables();
+    const CaseTable &table = tables.f2l_tables[GetF2LSolvedMask()];
+    std::string moves;
+
+    RubikCube3Cubie cubie(cube_);
+    int pair_case = GetPairCase(cubie);
+    CheckProgress(table.cost[pair_case] != unknown_cost, "CFOP pair");
+    while (table.cost[pair_case] > 0) {
+        const Macro &macro = tables.f2l_macros[table.macro[pair_case]];
+        moves += MoveCube(macro.moves);
+        cubie.Multiply(macro.cubie);
+        const int cost = table.cost[pair_case];
+        pair_case = GetPairCase(cubie);
+        CheckProgress(table.cost[pair_case] < cost, "CFOP pair");
+    }
+
+    return moves;
+}
+
+
+// Step 3: Orient Last Layer
+bool RubikCube3CFOPSolver::IsLastLayerOriented() {
+    return GetOLLCase(RubikCube3Cubie(cube_)) == 0;
+}
+
+
+std::string RubikCube3CFOPSolver::SolveOLL() {
+    const CFOPTables &tables = GetCFOPTables();
+    std::string moves;
+
+    RubikCube3Cubie cubie(cube_);
+    int oll_case = GetOLLCase(cubie);
+    CheckProgress(tables.oll_table.cost[oll_case] != unknown_cost, "CFOP OLL");
+    while (tables.oll_table.cost[oll_case] > 0) {
+        const Macro &macro = tables.oll_macros[tables.oll_table.macro[oll_case]];
+        moves += MoveCube(macro.moves);
+        cubie.Multiply(macro.cubie);
+        const int cost = tables.oll_table.cost[oll_case];
+        oll_case = GetOLLCase(cubie);
+        CheckProgress(tables.oll_table.cost[oll_case] < cost, "CFOP OLL");
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Step 4: Permute Last Layer
+bool RubikCube3CFOPSolver::IsLastLayerPermuted() {
+    return RubikCube3Cubie(cube_).IsSolved();
+}
+
+
+std::string RubikCube3CFOPSolver::SolvePLL() {
+    const CFOPTables &tables = GetCFOPTables();
+    std::string moves;
+
+    RubikCube3Cubie cubie(cube_);
+    int pll_case = GetPLLCase(cubie);
+    CheckProgress(tables.pll_table.cost[pll_case] != unknown_cost, "CFOP PLL");
+    while (tables.pll_table.cost[pll_case] > 0) {
+        const Macro &macro = tables.pll_macros[tables.pll_table.macro[pll_case]];
+        moves += MoveCube(macro.moves);
+        cubie.Multiply(macro.cubie);
+        const int cost = tables.pll_table.cost[pll_case];
+        pll_case = GetPLLCase(cubie);
+        CheckProgress(tables.pll_table.cost[pll_case] < cost, "CFOP PLL");
+    }
+
+    return cube_.CompressMoves(moves);
+}
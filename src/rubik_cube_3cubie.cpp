@@ -0,0 +1,266 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_3cubie.hpp"
+
+#include <cstring>
+#include <cassert>
+
+using namespace rb;
+
+struct FaceletCoord {
+    char face;
+    char idx;   // row * 3 + col
+};
+
+// Facelets of each corner position, listed clockwise starting from the U/D facelet.
+static const FaceletCoord corner_facelets[CORNER_NUM][3] = {
+    {{U, 8}, {R, 0}, {F, 2}},   // URF
+    {{U, 6}, {F, 0}, {L, 2}},   // UFL
+    {{U, 0}, {L, 0}, {B, 2}},   // ULB
+    {{U, 2}, {B, 0}, {R, 2}},   // UBR
+    {{D, 2}, {F, 8}, {R, 6}},   // DFR
+    {{D, 0}, {L, 8}, {F, 6}},   // DLF
+    {{D, 6}, {B, 8}, {L, 6}},   // DBL
+    {{D, 8}, {R, 8}, {B, 6}},   // DRB
+};
+
+static const FaceletCoord edge_facelets[EDGE_NUM][2] = {
+    {{U, 5}, {R, 1}},   // UR
+    {{U, 7}, {F, 1}},   // UF
+    {{U, 3}, {L, 1}},   // UL
+    {{U, 1}, {B, 1}},   // UB
+    {{D, 5}, {R, 7}},   // DR
+    {{D, 1}, {F, 7}},   // DF
+    {{D, 3}, {L, 7}},   // DL
+    {{D, 7}, {B, 7}},   // DB
+    {{F, 5}, {R, 3}},   // FR
+    {{F, 3}, {L, 5}},   // FL
+    {{B, 5}, {L, 3}},   // BL
+    {{B, 3}, {R, 5}},   // BR
+};
+
+
+RubikCube3Cubie::RubikCube3Cubie() {
+    for (int i = 0; i < CORNER_NUM; i ++) {
+        cp[i] = i;
+        co[i] = 0;
+    }
+    for (int i = 0; i < EDGE_NUM; i ++) {
+        ep[i] = i;
+        eo[i] = 0;
+    }
+}
+
+
+RubikCube3Cubie::RubikCube3Cubie(RubikCube& cube) {
+    assert(cube.GetDim() == 3);
+
+    // Map each facelet to the face whose center has the same color,
+    // so the cubies are relative to the current cube orientation.
+    char center_chars[UNKNOWN_FACE];
+    for (int f = 0; f < UNKNOWN_FACE; f ++)
+        center_chars[f] = cube.GetPieceChar((CUBE_FACE)f, 1, 1, false);
+
+    unsigned char facelet_faces[UNKNOWN_FACE * 9];
+    for (int i = 0; i < UNKNOWN_FACE * 9; i ++) {
+        char piece_char = cube.GetPieceChar((CUBE_FACE)(i / 9), (i % 9) / 3, i % 3, false);
+        facelet_faces[i] = UNKNOWN_FACE;
+        for (int f = 0; f < UNKNOWN_FACE; f ++)
+            if (center_chars[f] == piece_char)
+                facelet_faces[i] = f;
+        assert(facelet_faces[i] != UNKNOWN_FACE);
+    }
+
+    CUBE_STATE state = SetFacelets(facelet_faces);
+    assert(state == CUBE_STATE_VALID);
+    (void)state;
+}
+
+
+// Piece and orientation of every facelet face combination, packed as piece * 3 + ori
+// for corners and piece * 2 + ori for edges, invalid_piece if no such piece exists.
+static const unsigned char invalid_piece = 0xFF;
+
+struct PieceLookup {
+    PieceLookup() {
+        std::memset(corners, invalid_piece, sizeof(corners));
+        std::memset(edges, invalid_piece, sizeof(edges));
+
+        for (int j = 0; j < CORNER_NUM; j ++) {
+            for (int ori = 0; ori < 3; ori ++) {
+                int faces[3];
+                for (int k = 0; k < 3; k ++)
+                    faces[(ori + k) % 3] = corner_facelets[j][k].face;
+                corners[(faces[0] * UNKNOWN_FACE + faces[1]) * UNKNOWN_FACE + faces[2]] = j * 3 + ori;
+            }
+        }
+        for (int j = 0; j < EDGE_NUM; j ++) {
+            edges[edge_facelets[j][0].face * UNKNOWN_FACE + edge_facelets[j][1].face] = j * 2;
+            edges[edge_facelets[j][1].face * UNKNOWN_FACE + edge_facelets[j][0].face] = j * 2 + 1;
+        }
+    }
+    unsigned char corners[UNKNOWN_FACE * UNKNOWN_FACE * UNKNOWN_FACE];
+    unsigned char edges[UNKNOWN_FACE * UNKNOWN_FACE];
+};
+
+
+CUBE_STATE RubikCube3Cubie::SetFacelets(const unsigned char* facelet_faces) {
+    static const PieceLookup lookup;
+
+    auto facelet_face = [&](const FaceletCoord& fc) {
+        return (int)facelet_faces[fc.face * 9 + fc.idx];
+    };
+
+    int corner_mask = 0;
+    for (int i = 0; i < CORNER_NUM; i ++) {
+        const FaceletCoord *fcs = corner_facelets[i];
+        int piece = lookup.corners[(facelet_face(fcs[0]) * UNKNOWN_FACE + facelet_face(fcs[1])) * UNKNOWN_FACE +
+                                   facelet_face(fcs[2])];
+        if (piece == invalid_piece || (corner_mask & (1 << (piece / 3))))
+            return CUBE_STATE_BAD_CORNER;
+        cp[i] = piece / 3;
+        co[i] = piece % 3;
+        corner_mask |= 1 << cp[i];
+    }
+
+    int edge_mask = 0;
+    for (int i = 0; i < EDGE_NUM; i ++) {
+        const FaceletCoord *fcs = edge_facelets[i];
+        int piece = lookup.edges[facelet_face(fcs[0]) * UNKNOWN_FACE + facelet_face(fcs[1])];
+        if (piece == invalid_piece || (edge_mask & (1 << (piece >> 1))))
+            return CUBE_STATE_BAD_EDGE;
+        ep[i] = piece >> 1;
+        eo[i] = piece & 1;
+        edge_mask |= 1 << ep[i];
+    }
+
+    return CUBE_STATE_VALID;
+}
+
+
+CUBE_STATE RubikCube3Cubie::Verify() const {
+    int twist = 0;
+    for (int i = 0; i < CORNER_NUM; i ++)
+        twist += co[i];
+    if (twist % 3)
+        return CUBE_STATE_TWISTED_CORNER;
+
+    int flip = 0;
+    for (int i = 0; i < EDGE_NUM; i ++)
+        flip += eo[i];
+    if (flip & 1)
+        return CUBE_STATE_FLIPPED_EDGE;
+
+    // Count inversions, both permutations must be even or both odd
+    int parity = 0;
+    for (int i = 0; i < CORNER_NUM; i ++)
+        for (int j = i + 1; j < CORNER_NUM; j ++)
+            parity ^= (cp[i] > cp[j]);
+    for (int i = 0; i < EDGE_NUM; i ++)
+        for (int j = i + 1; j < EDGE_NUM; j ++)
+            parity ^= (ep[i] > ep[j]);
+    if (parity)
+        return CUBE_STATE_BAD_PARITY;
+
+    return CUBE_STATE_VALID;
+}
+
+
+bool RubikCube3Cubie::IsSolved() const {
+    for (int i = 0; i < CORNER_NUM; i ++)
+        if (cp[i] != i || co[i] != 0)
+            return false;
+    for (int i = 0; i < EDGE_NUM; i ++)
+        if (ep[i] != i || eo[i] != 0)
+            return false;
+    return true;
+}
+
+
+void RubikCube3Cubie::Multiply(const RubikCube3Cubie& other) {
+    unsigned char new_cp[CORNER_NUM], new_co[CORNER_NUM];
+    unsigned char new_ep[EDGE_NUM], new_eo[EDGE_NUM];
+
+    for (int i = 0; i < CORNER_NUM; i ++) {
+        new_cp[i] = cp[other.cp[i]];
+        new_co[i] = (co[other.cp[i]] + other.co[i]) % 3;
+    }
+    for (int i = 0; i < EDGE_NUM; i ++) {
+        new_ep[i] = ep[other.ep[i]];
+        new_eo[i] = eo[other.ep[i]] ^ other.eo[i];
+    }
+
+    std::memcpy(cp, new_cp, CORNER_NUM);
+    std::memcpy(co, new_co, CORNER_NUM);
+    std::memcpy(ep, new_ep, EDGE_NUM);
+    std::memcpy(eo, new_eo, EDGE_NUM);
+}
+
+
+void RubikCube3Cubie::Move(const int& move_idx) {
+    Multiply(GetMoveCubie(move_idx));
+}
+
+
+void RubikCube3Cubie::Move(const std::string& moves) {
+    for (int i = 0; i < moves.length(); i ++) {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        CUBE_FACE face = CvtFaceCharToFace(moves[i]);
+        assert(face != UNKNOWN_FACE);
+
+        int turn = 0;
+        // peek next char
+        if ((i + 1) < moves.length()) {
+            if (moves[i + 1] == '\'' || moves[i + 1] == 'i')
+                turn = 2;
+            else if (moves[i + 1] == '2')
+                turn = 1;
+        }
+        Move(face * 3 + turn);
+    }
+}
+
+
+const RubikCube3Cubie& RubikCube3Cubie::GetMoveCubie(const int& move_idx) {
+    assert(move_idx >= 0 && move_idx < face_move_num);
+
+    // Derive the cubie of every face turn from RubikCube itself,
+    // so both representations always share the same move semantics.
+    struct MoveCubies {
+        MoveCubies() {
+            for (int i = 0; i < face_move_num; i ++) {
+                RubikCube cube(3);
+                cube.Move(GetMoveString(i));
+                cubies[i] = RubikCube3Cubie(cube);
+            }
+        }
+        RubikCube3Cubie cubies[face_move_num];
+    };
+    static const MoveCubies move_cubies;
+
+    return move_cubies.cubies[move_idx];
+}
+
+
+std::string RubikCube3Cubie::GetMoveString(const int& move_idx) {
+    static const char* face_chars = "ULFRBD";
+    static const char* turn_suffixes[3] = {"", "2", "'"};
+
+    assert(move_idx >= 0 && move_idx < face_move_num);
+    return std::string(1, face_chars[move_idx / 3]) + turn_suffixes[move_idx % 3];
+}
@@ -0,0 +1,112 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "rubik_cube.hpp"
+#include "rubik_cube_validator.hpp"
+
+#include <string>
+
+
+namespace rb {
+
+enum CUBIE_CORNER {
+    URF = 0,
+    UFL,
+    ULB,
+    UBR,
+    DFR,
+    DLF,
+    DBL,
+    DRB,
+    CORNER_NUM
+};
+
+enum CUBIE_EDGE {
+    UR = 0,
+    UF,
+    UL,
+    UB,
+    DR,
+    DF,
+    DL,
+    DB,
+    FR,
+    FL,
+    BL,
+    BR,
+    EDGE_NUM
+};
+
+// Face turns are indexed as face * 3 + turn, where face follows CUBE_FACE
+// (U, L, F, R, B, D) and turn is 0 for CW, 1 for half turn, 2 for CCW.
+static const int face_move_num = 18;
+
+
+// Corner and edge level representation of a 3x3x3 cube.
+// cp[i]/ep[i] is the piece placed at position i, co[i]/eo[i] its orientation.
+struct RubikCube3Cubie {
+    RubikCube3Cubie();
+    RubikCube3Cubie(RubikCube& cube);
+
+    // facelet_faces holds the face (CUBE_FACE) each of the 54 facelets belongs to.
+    // Returns CUBE_STATE_BAD_CORNER/EDGE if a piece doesn't exist or appears twice.
+    CUBE_STATE SetFacelets(const unsigned char* facelet_faces);
+    // Check corner twist, edge flip and permutation parity
+    CUBE_STATE Verify() const;
+
+    bool IsSolved() const;
+    void Multiply(const RubikCube3Cubie& other);
+    void Move(const int& move_idx);
+    void Move(const std::string& moves);
+
+    static const RubikCube3Cubie& GetMoveCubie(const int& move_idx);
+    static std::string GetMoveString(const int& move_idx);
+
+    unsigned char cp[CORNER_NUM];
+    unsigned char co[CORNER_NUM];
+    unsigned char ep[EDGE_NUM];
+    unsigned char eo[EDGE_NUM];
+};
+
+
+// Coordinates the solvers index their tables by: twists of the first 7 corners,
+// flips of the first 11 edges, and the mask of the positions holding E-slice edges
+inline int GetCOCoord(const RubikCube3Cubie& cubie) {
+    int coord = 0;
+    for (int i = CORNER_NUM - 2; i >= 0; i --)
+        coord = coord * 3 + cubie.co[i];
+    return coord;
+}
+
+
+inline int GetEOCoord(const RubikCube3Cubie& cubie) {
+    int coord = 0;
+    for (int i = 0; i < EDGE_NUM - 1; i ++)
+        coord |= cubie.eo[i] << i;
+    return coord;
+}
+
+
+inline int GetSliceMask(const RubikCube3Cubie& cubie) {
+    int mask = 0;
+    for (int i = 0; i < EDGE_NUM; i ++)
+        if (cubie.ep[i] >= FR)
+            mask |= 1 << i;
+    return mask;
+}
+
+}
@@ -0,0 +1,364 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_3subgroup_bfs.hpp"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+using namespace rb;
+
+static const size_t chunk_coord_num = 1 << 20;   // 8 MB of coordinates per frontier chunk
+static const size_t work_coord_num = 1 << 14;    // coordinates expanded per work item
+
+
+// Frontier of one depth, in chunks of coordinates. Chunks are kept in memory
+// up to a byte budget, later ones are written to files and read back on demand.
+class RubikCube3SubgroupBFS::Frontier {
+  public:
+    Frontier(const std::string& spill_path, const uint64_t& max_memory):
+        spill_path_(spill_path), max_memory_(max_memory), memory_(0), coord_num_(0), spill_fd_(-1) {}
+    ~Frontier() {
+        if (spill_fd_ >= 0) {
+            close(spill_fd_);
+            unlink(spill_path_.c_str());
+        }
+    }
+
+    uint64_t GetCoordNum() const { return coord_num_; }
+    size_t GetChunkNum() const { return chunks_.size(); }
+
+    void Add(std::vector<uint64_t>& coords) {
+        if (coords.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Chunk chunk;
+        chunk.coord_num = coords.size();
+        const uint64_t bytes = coords.size() * sizeof(uint64_t);
+        if (memory_ + bytes <= max_memory_) {
+            chunk.coords.swap(coords);
+            memory_ += bytes;
+        } else {
+            if (spill_fd_ < 0) {
+                spill_fd_ = open(spill_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                assert(spill_fd_ >= 0);
+                spill_offset_ = 0;
+            }
+            chunk.file_offset = spill_offset_;
+            ssize_t ret = pwrite(spill_fd_, coords.data(), bytes, spill_offset_);
+            assert(ret == bytes);
+            (void)ret;
+            spill_offset_ += bytes;
+        }
+        coord_num_ += chunk.coord_num;
+        chunks_.push_back(chunk);
+        coords.clear();
+    }
+
+    size_t GetChunkCoordNum(const size_t& idx) const { return chunks_[idx].coord_num; }
+
+    // Returns coord_num coordinates of a chunk from begin, read into buf if the chunk was spilled
+    const uint64_t* GetCoords(const size_t& idx, const size_t& begin, const size_t& coord_num,
+                              std::vector<uint64_t>& buf) const {
+        const Chunk &chunk = chunks_[idx];
+        if (!chunk.coords.empty())
+            return chunk.coords.data() + begin;
+
+        buf.resize(coord_num);
+        const size_t bytes = coord_num * sizeof(uint64_t);
+        ssize_t ret = pread(spill_fd_, buf.data(), bytes, chunk.file_offset + begin * sizeof(uint64_t));
+        assert(ret == bytes);
+        (void)ret;
+        return buf.data();
+    }
+
+  private:
+    struct Chunk {
+        std::vector<uint64_t> coords;
+        size_t coord_num;
+        off_t file_offset;
+    };
+
+    std::string spill_path_;
+    uint64_t max_memory_;
+    uint64_t memory_;
+    uint64_t coord_num_;
+    int spill_fd_;
+    off_t spill_offset_;
+    std::vector<Chunk> chunks_;
+    std::mutex mutex_;
+};
+
+
+RubikCube3SubgroupBFS::RubikCube3SubgroupBFS(const std::string& moves, const SUBGROUP_PIECES& pieces/* = ALL_PIECES*/):
+    coord_num_(1) {
+    for (int i = 0; i < moves.length(); i ++) {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        CUBE_FACE face = CvtFaceCharToFace(moves[i]);
+        assert(face != UNKNOWN_FACE);
+
+        // peek next char
+        if ((i + 1) < moves.length() && moves[i + 1] == '2') {
+            moves_.push_back(face * 3 + 1);
+        } else if ((i + 1) < moves.length() && (moves[i + 1] == '\'' || moves[i + 1] == 'i')) {
+            moves_.push_back(face * 3 + 2);
+        } else {
+            for (int t = 0; t < 3; t ++)
+                moves_.push_back(face * 3 + t);
+        }
+    }
+    assert(!moves_.empty());
+
+    // Group positions into orbits, the moves never take a piece out of its orbit
+    for (int type = 0; type < 2; type ++) {
+        const bool is_corner = (type == 0);
+        if ((is_corner && pieces == EDGE_PIECES) || (!is_corner && pieces == CORNER_PIECES))
+            continue;
+
+        const int position_num = is_corner? (int)CORNER_NUM: (int)EDGE_NUM;
+        int orbit_ids[EDGE_NUM];
+        for (int p = 0; p < position_num; p ++)
+            orbit_ids[p] = p;
+
+        bool is_oriented = false;
+        for (int m = 0; m < moves_.size(); m ++) {
+            const RubikCube3Cubie &move = RubikCube3Cubie::GetMoveCubie(moves_[m]);
+            for (int p = 0; p < position_num; p ++) {
+                int from = orbit_ids[is_corner? move.cp[p]: move.ep[p]];
+                int to = orbit_ids[p];
+                for (int q = 0; q < position_num; q ++)
+                    if (orbit_ids[q] == from)
+                        orbit_ids[q] = to;
+                is_oriented |= (is_corner? move.co[p]: move.eo[p]) != 0;
+            }
+        }
+
+        std::vector<int> moved_positions;
+        for (int id = 0; id < position_num; id ++) {
+            Orbit orbit;
+            orbit.is_corner = is_corner;
+            for (int p = 0; p < position_num; p ++) {
+                if (orbit_ids[p] == id) {
+                    orbit.local_idxs[p] = orbit.positions.size();
+                    orbit.positions.push_back(p);
+                }
+            }
+            if (orbit.positions.size() < 2)
+                continue;
+
+            moved_positions.insert(moved_positions.end(), orbit.positions.begin(), orbit.positions.end());
+            for (int n = 2; n <= orbit.positions.size(); n ++)
+                coord_num_ *= n;
+            orbits_.push_back(orbit);
+        }
+
+        // Twists (flips) of all pieces add up to a multiple of 3 (2),
+        // so the last moved piece's orientation follows from the others
+        if (is_oriented && !moved_positions.empty()) {
+            std::vector<int> &oriented = is_corner? twisted_corners_: flipped_edges_;
+            oriented.assign(moved_positions.begin(), moved_positions.end() - 1);
+            for (int i = 0; i < oriented.size(); i ++)
+                coord_num_ *= is_corner? 3: 2;
+        }
+    }
+}
+
+
+uint64_t RubikCube3SubgroupBFS::Rank(const RubikCube3Cubie& cubie) const {
+    uint64_t coord = 0;
+
+    for (int o = 0; o < orbits_.size(); o ++) {
+        const Orbit &orbit = orbits_[o];
+        const unsigned char *perm = orbit.is_corner? cubie.cp: cubie.ep;
+        const int n = orbit.positions.size();
+
+        // Lehmer code of the pieces in the orbit
+        int used_mask = 0;
+        for (int i = 0; i < n; i ++) {
+            const int piece = orbit.local_idxs[perm[orbit.positions[i]]];
+            coord = coord * (n - i) + (piece - __builtin_popcount(used_mask & ((1 << piece) - 1)));
+            used_mask |= 1 << piece;
+        }
+    }
+    for (int i = 0; i < twisted_corners_.size(); i ++)
+        coord = coord * 3 + cubie.co[twisted_corners_[i]];
+    for (int i = 0; i < flipped_edges_.size(); i ++)
+        coord = coord * 2 + cubie.eo[flipped_edges_[i]];
+
+    return coord;
+}
+
+
+void RubikCube3SubgroupBFS::Unrank(uint64_t coord, RubikCube3Cubie& cubie) const {
+    cubie = RubikCube3Cubie();
+
+    int flip_sum = 0;
+    for (int i = flipped_edges_.size() - 1; i >= 0; i --) {
+        cubie.eo[flipped_edges_[i]] = coord % 2;
+        flip_sum += coord % 2;
+        coord /= 2;
+    }
+
+    int twist_sum = 0;
+    for (int i = twisted_corners_.size() - 1; i >= 0; i --) {
+        cubie.co[twisted_corners_[i]] = coord % 3;
+        twist_sum += coord % 3;
+        coord /= 3;
+    }
+
+    int last_corner = -1, last_edge = -1;
+    for (int o = orbits_.size() - 1; o >= 0; o --) {
+        const Orbit &orbit = orbits_[o];
+        unsigned char *perm = orbit.is_corner? cubie.cp: cubie.ep;
+        const int n = orbit.positions.size();
+
+        int digits[EDGE_NUM];
+        for (int i = n - 1; i >= 0; i --) {
+            digits[i] = coord % (n - i);
+            coord /= (n - i);
+        }
+
+        int used_mask = 0;
+        for (int i = 0; i < n; i ++) {
+            // Pick the digits[i]-th unused piece
+            int piece = 0;
+            for (int k = digits[i]; ; piece ++)
+                if (!(used_mask & (1 << piece)) && (k -- == 0))
+                    break;
+            used_mask |= 1 << piece;
+            perm[orbit.positions[i]] = orbit.positions[piece];
+        }
+
+        if (orbit.is_corner && last_corner < 0)
+            last_corner = orbit.positions.back();
+        if (!orbit.is_corner && last_edge < 0)
+            last_edge = orbit.positions.back();
+    }
+
+    if (!twisted_corners_.empty())
+        cubie.co[last_corner] = (3 - twist_sum % 3) % 3;
+    if (!flipped_edges_.empty())
+        cubie.eo[last_edge] = flip_sum & 1;
+}
+
+
+void RubikCube3SubgroupBFS::ExpandChunk(const uint64_t* coords, const size_t& coord_num, uint64_t* visited,
+                                        std::vector<uint64_t>& next_coords, Frontier& next) const {
+    RubikCube3Cubie cubie, moved;
+    for (size_t i = 0; i < coord_num; i ++) {
+        Unrank(coords[i], cubie);
+        for (int m = 0; m < moves_.size(); m ++) {
+            moved = cubie;
+            moved.Multiply(RubikCube3Cubie::GetMoveCubie(moves_[m]));
+            const uint64_t coord = Rank(moved);
+            const uint64_t bit = (uint64_t)1 << (coord & 63);
+            if (__atomic_fetch_or(&visited[coord >> 6], bit, __ATOMIC_RELAXED) & bit)
+                continue;
+
+            next_coords.push_back(coord);
+            if (next_coords.size() >= chunk_coord_num)
+                next.Add(next_coords);
+        }
+    }
+}
+
+
+std::vector<uint64_t> RubikCube3SubgroupBFS::Run(const int& thread_num, const uint64_t& max_memory,
+                                                 const std::string& spill_dir) {
+    assert(thread_num > 0);
+
+    // Visited bits, file backed if they would take most of the memory budget
+    const size_t visited_bytes = ((coord_num_ + 63) >> 6) * sizeof(uint64_t);
+    const bool is_visited_spilled = (visited_bytes > max_memory / 2);
+    const std::string visited_path = spill_dir + "/bfs_visited.bin";
+    int visited_fd = -1;
+    if (is_visited_spilled) {
+        visited_fd = open(visited_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        assert(visited_fd >= 0);
+        int ret = ftruncate(visited_fd, visited_bytes);
+        assert(ret == 0);
+        (void)ret;
+    }
+    void *visited_mem = mmap(NULL, visited_bytes, PROT_READ | PROT_WRITE,
+                             is_visited_spilled? MAP_SHARED: (MAP_PRIVATE | MAP_ANONYMOUS), visited_fd, 0);
+    assert(visited_mem != MAP_FAILED);
+    uint64_t *visited = (uint64_t*)visited_mem;
+
+    const uint64_t frontier_memory = is_visited_spilled? max_memory: (max_memory - visited_bytes);
+    std::vector<uint64_t> distribution;
+
+    RubikCube3Cubie solved;
+    std::vector<uint64_t> solved_coords(1, Rank(solved));
+    visited[solved_coords[0] >> 6] |= (uint64_t)1 << (solved_coords[0] & 63);
+
+    std::unique_ptr<Frontier> curr(new Frontier(spill_dir + "/bfs_frontier_0.bin", frontier_memory / 2));
+    curr->Add(solved_coords);
+
+    for (int depth = 1; curr->GetCoordNum() > 0; depth ++) {
+        distribution.push_back(curr->GetCoordNum());
+
+        std::unique_ptr<Frontier> next(new Frontier(spill_dir + "/bfs_frontier_" + std::to_string(depth & 1) + ".bin",
+                                                    frontier_memory / 2));
+
+        // Split chunks into small work items, so small frontiers are shared by all threads too
+        std::vector<std::pair<size_t, size_t> > work_items;
+        for (size_t c = 0; c < curr->GetChunkNum(); c ++)
+            for (size_t begin = 0; begin < curr->GetChunkCoordNum(c); begin += work_coord_num)
+                work_items.push_back(std::make_pair(c, begin));
+
+        std::atomic<size_t> next_item(0);
+        auto worker = [&]() {
+            std::vector<uint64_t> buf, next_coords;
+            next_coords.reserve(chunk_coord_num);
+            for (size_t w = next_item ++; w < work_items.size(); w = next_item ++) {
+                const size_t chunk_idx = work_items[w].first;
+                const size_t begin = work_items[w].second;
+                const size_t coord_num = std::min(work_coord_num, curr->GetChunkCoordNum(chunk_idx) - begin);
+                const uint64_t *coords = curr->GetCoords(chunk_idx, begin, coord_num, buf);
+                ExpandChunk(coords, coord_num, visited, next_coords, *next);
+            }
+            next->Add(next_coords);
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < thread_num; t ++)
+            workers.push_back(std::thread(worker));
+        worker();
+        for (int t = 0; t < workers.size(); t ++)
+            workers[t].join();
+
+        curr.swap(next);
+    }
+
+    munmap(visited_mem, visited_bytes);
+    if (visited_fd >= 0) {
+        close(visited_fd);
+        unlink(visited_path.c_str());
+    }
+    return distribution;
+}
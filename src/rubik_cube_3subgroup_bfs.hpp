@@ -0,0 +1,76 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "rubik_cube_3cubie.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+namespace rb {
+
+enum SUBGROUP_PIECES {
+    ALL_PIECES = 0,
+    CORNER_PIECES,      // e.g. <U, R, F> on corners is the whole 2x2x2 group
+    EDGE_PIECES
+};
+
+// Breadth-first enumeration of the states reachable from the solved cube with a
+// restricted set of face turns, reporting how many states are at each distance.
+//
+// States are ranked into a coordinate over only the pieces the moves can reach:
+// a permutation rank per orbit of positions, plus orientations if any move changes
+// them. Visited states are one bit each; the frontier of every depth is kept in
+// chunks, and chunks over the memory budget are spilled to files.
+class RubikCube3SubgroupBFS {
+  public:
+    // moves lists face turns, a face alone means all its turns,
+    // e.g. "U R" or "U D F2 B2 L2 R2"
+    RubikCube3SubgroupBFS(const std::string& moves, const SUBGROUP_PIECES& pieces = ALL_PIECES);
+
+    // Size of the coordinate, an upper bound of the number of states
+    uint64_t GetCoordNum() const { return coord_num_; }
+    const std::vector<int>& GetMoves() const { return moves_; }
+
+    // Returns the number of states at each distance. Visited bits are file backed
+    // in spill_dir when they don't fit in max_memory bytes.
+    std::vector<uint64_t> Run(const int& thread_num, const uint64_t& max_memory, const std::string& spill_dir);
+
+    uint64_t Rank(const RubikCube3Cubie& cubie) const;
+    void Unrank(uint64_t coord, RubikCube3Cubie& cubie) const;
+
+  private:
+    struct Orbit {
+        bool is_corner;
+        std::vector<int> positions;
+        int local_idxs[EDGE_NUM];       // position to index in positions
+    };
+
+    class Frontier;
+
+    void ExpandChunk(const uint64_t* coords, const size_t& coord_num, uint64_t* visited,
+                     std::vector<uint64_t>& next_coords, Frontier& next) const;
+
+    std::vector<int> moves_;
+    std::vector<Orbit> orbits_;
+    std::vector<int> twisted_corners_;  // moved corners whose twist is a coordinate
+    std::vector<int> flipped_edges_;    // moved edges whose flip is a coordinate
+    uint64_t coord_num_;
+};
+
+}
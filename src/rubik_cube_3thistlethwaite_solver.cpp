@@ -0,0 +1,672 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_3cubie.hpp"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+
+using namespace rb;
+
+static const unsigned char unknown_dist = 0xff;
+
+// Phase 1: edge orientation of the first 11 edges
+static const int eo_coord_num = 1 << 11;
+// Phase 2: corner orientation of the first 7 corners, and positions of E-slice edges
+static const int co_coord_num = 2187;
+static const int slice_coord_num = 495;
+// Phase 3: corner permutation cosets of G3, and positions of M-slice edges among U/D layer edges
+static const int corner_coset_num = 420;
+static const int m_edge_coord_num = 70;
+// Phase 4: corner permutations of G3, and edge permutations inside each of the 3 slices
+static const int tetrad_coord_num = 96;
+static const int slice_perm_coord_num = 24;
+
+// Maximum moves of each phase
+static const int max_phase_depth[4] = {7, 10, 13, 15};
+
+static const int opposite_faces[UNKNOWN_FACE] = {D, R, B, L, F, U};
+static const double cost_epsilon = 1e-9;      // costs summed in different orders may differ by rounding
+
+// Corner tetrads {URF, ULB, DLF, DRB} and {UFL, UBR, DFR, DBL},
+// and edge slices M {UF, UB, DF, DB}, S {UR, UL, DR, DL} and E {FR, FL, BL, BR}
+static const int corner_local_idx[CORNER_NUM] = {0, 0, 1, 1, 2, 2, 3, 3};
+static const int edge_local_idx[EDGE_NUM] = {0, 0, 1, 1, 2, 2, 3, 3, 0, 1, 2, 3};
+static const int tetrad_corners[2][4] = {{URF, ULB, DLF, DRB}, {UFL, UBR, DFR, DBL}};
+static const int slice_edges[3][4] = {{UF, UB, DF, DB}, {UR, UL, DR, DL}, {FR, FL, BL, BR}};
+
+
+struct ThistlethwaiteTables {
+    ThistlethwaiteTables();
+
+    std::vector<int> phase_moves[4];
+
+    // Phase 1
+    std::vector<unsigned char> eo_dist;
+
+    // Phase 2
+    std::vector<unsigned short> co_moves;
+    std::vector<unsigned short> slice_moves;
+    std::vector<short> slice_ranks;                // E-slice edges mask -> rank
+    std::vector<unsigned char> co_dist;
+    std::vector<unsigned char> slice_dist;
+    std::vector<unsigned char> edge_pos_moves;
+    std::vector<unsigned char> co_edge_dist;       // corner orientation x position of an E-slice edge
+
+    // Phase 3
+    std::vector<RubikCube3Cubie> corner_group;     // corner permutations of G3
+    std::vector<int> corner_coset_ranks;           // canonical rank of each coset, sorted
+    std::vector<unsigned short> corner_coset_moves;
+    std::vector<short> m_edge_ranks;               // U/D layer mask of M-slice edges -> rank
+    std::vector<unsigned char> g3_dist;
+
+    // Phase 4
+    std::vector<short> tetrad_idxs;                // tetrad permutation ranks -> corner_group index
+    std::vector<unsigned char> tetrad_moves;
+    std::vector<unsigned char> slice_perm_moves[3];
+    std::vector<unsigned char> corner_slice_dist[3];
+    std::vector<unsigned char> slice_perm_dist;
+};
+
+
+// Phase 2 search state, edge_pos are the positions of the 4 E-slice edges
+struct G2State {
+    G2State() {}
+    G2State(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie);
+
+    int GetHeuristic(const ThistlethwaiteTables& tables) const {
+        int h = std::max(tables.co_dist[co], tables.slice_dist[slice]);
+        for (int e = 0; e < 4; e ++)
+            h = std::max(h, (int)tables.co_edge_dist[co * EDGE_NUM + edge_pos[e]]);
+        return h;
+    }
+
+    G2State Move(const ThistlethwaiteTables& tables, const int& move_pos) const {
+        const int move_num = tables.phase_moves[1].size();
+        G2State next;
+        next.co = tables.co_moves[co * move_num + move_pos];
+        next.slice = tables.slice_moves[slice * move_num + move_pos];
+        for (int e = 0; e < 4; e ++)
+            next.edge_pos[e] = tables.edge_pos_moves[edge_pos[e] * move_num + move_pos];
+        return next;
+    }
+
+    int co;
+    int slice;
+    int edge_pos[4];
+};
+
+// Phase 4 search state
+struct G4State {
+    G4State() {}
+    G4State(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie);
+
+    int GetHeuristic(const ThistlethwaiteTables& tables) const {
+        int h = tables.slice_perm_dist[(perms[0] * 24 + perms[1]) * 24 + perms[2]];
+        for (int s = 0; s < 3; s ++)
+            h = std::max(h, (int)tables.corner_slice_dist[s][tetrad * 24 + perms[s]]);
+        return h;
+    }
+
+    G4State Move(const ThistlethwaiteTables& tables, const int& move_pos) const {
+        const int move_num = tables.phase_moves[3].size();
+        G4State next;
+        next.tetrad = tables.tetrad_moves[tetrad * move_num + move_pos];
+        for (int s = 0; s < 3; s ++)
+            next.perms[s] = tables.slice_perm_moves[s][perms[s] * move_num + move_pos];
+        return next;
+    }
+
+    int tetrad;
+    int perms[3];
+};
+
+
+inline int GetPermRank(const int* perm, const int& n) {
+    int rank = 0;
+    for (int i = 0; i < n; i ++) {
+        int less_cnt = 0;
+        for (int j = i + 1; j < n; j ++)
+            if (perm[j] < perm[i])
+                less_cnt ++;
+        rank = rank * (n - i) + less_cnt;
+    }
+    return rank;
+}
+
+
+inline int GetMEdgeMask(const RubikCube3Cubie& cubie) {
+    int mask = 0;
+    for (int i = 0; i < FR; i ++)
+        if (cubie.ep[i] == UF || cubie.ep[i] == UB || cubie.ep[i] == DF || cubie.ep[i] == DB)
+            mask |= 1 << i;
+    return mask;
+}
+
+
+// Positions of the set bits after a move, for masks over the first mask_bits positions
+inline int GetMaskAfter(const RubikCube3Cubie& move, const int& mask, const int& mask_bits) {
+    int next_mask = 0;
+    for (int i = 0; i < mask_bits; i ++)
+        if (mask & (1 << move.ep[i]))
+            next_mask |= 1 << i;
+    return next_mask;
+}
+
+
+inline int GetCornerRank(const RubikCube3Cubie& cubie) {
+    int perm[CORNER_NUM];
+    for (int i = 0; i < CORNER_NUM; i ++)
+        perm[i] = cubie.cp[i];
+    return GetPermRank(perm, CORNER_NUM);
+}
+
+
+inline int GetTetradRanks(const RubikCube3Cubie& cubie) {
+    int ranks = 0;
+    for (int t = 0; t < 2; t ++) {
+        int perm[4];
+        for (int i = 0; i < 4; i ++)
+            perm[i] = corner_local_idx[cubie.cp[tetrad_corners[t][i]]];
+        ranks = ranks * 24 + GetPermRank(perm, 4);
+    }
+    return ranks;
+}
+
+
+inline int GetSlicePermRank(const RubikCube3Cubie& cubie, const int& slice) {
+    int perm[4];
+    for (int i = 0; i < 4; i ++)
+        perm[i] = edge_local_idx[cubie.ep[slice_edges[slice][i]]];
+    return GetPermRank(perm, 4);
+}
+
+
+// Rank of the smallest corner permutation in the G3 coset of the cubie
+static int GetCanonicalCornerRank(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie) {
+    int min_rank = -1;
+    for (int i = 0; i < tables.corner_group.size(); i ++) {
+        const RubikCube3Cubie &h = tables.corner_group[i];
+        int perm[CORNER_NUM];
+        for (int j = 0; j < CORNER_NUM; j ++)
+            perm[j] = h.cp[cubie.cp[j]];
+        int rank = GetPermRank(perm, CORNER_NUM);
+        if (min_rank < 0 || rank < min_rank)
+            min_rank = rank;
+    }
+    return min_rank;
+}
+
+
+static int GetCornerCoset(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie) {
+    int rank = GetCanonicalCornerRank(tables, cubie);
+    std::vector<int>::const_iterator it =
+        std::lower_bound(tables.corner_coset_ranks.begin(), tables.corner_coset_ranks.end(), rank);
+    assert(it != tables.corner_coset_ranks.end() && *it == rank);
+    return it - tables.corner_coset_ranks.begin();
+}
+
+
+G2State::G2State(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie):
+    co(GetCOCoord(cubie)), slice(tables.slice_ranks[GetSliceMask(cubie)]) {
+    for (int i = 0; i < EDGE_NUM; i ++)
+        if (cubie.ep[i] >= FR)
+            edge_pos[cubie.ep[i] - FR] = i;
+}
+
+
+G4State::G4State(const ThistlethwaiteTables& tables, const RubikCube3Cubie& cubie):
+    tetrad(tables.tetrad_idxs[GetTetradRanks(cubie)]) {
+    for (int s = 0; s < 3; s ++)
+        perms[s] = GetSlicePermRank(cubie, s);
+}
+
+
+// Breadth-first search over a coordinate, starting from the solved coordinates.
+// get_next(coord, move_pos) returns the coordinate after the move moves[move_pos].
+template <typename NextFunc>
+static void BuildDistTable(std::vector<unsigned char>& dist, const int& coord_num,
+                           const std::vector<int>& solved_coords,
+                           const std::vector<int>& moves, NextFunc get_next) {
+    dist.assign(coord_num, unknown_dist);
+    for (int i = 0; i < solved_coords.size(); i ++)
+        dist[solved_coords[i]] = 0;
+
+    std::vector<int> frontier(solved_coords);
+    for (int depth = 0; !frontier.empty(); depth ++) {
+        std::vector<int> next_frontier;
+        for (int i = 0; i < frontier.size(); i ++) {
+            for (int m = 0; m < moves.size(); m ++) {
+                int next_coord = get_next(frontier[i], m);
+                if (dist[next_coord] == unknown_dist) {
+                    dist[next_coord] = depth + 1;
+                    next_frontier.push_back(next_coord);
+                }
+            }
+        }
+        frontier.swap(next_frontier);
+    }
+}
+
+
+ThistlethwaiteTables::ThistlethwaiteTables() {
+    for (int m = 0; m < face_move_num; m ++) {
+        int face = m / 3;
+        bool is_half = (m % 3 == 1);
+        phase_moves[0].push_back(m);
+        if (is_half || (face != F && face != B))
+            phase_moves[1].push_back(m);
+        if (is_half || face == U || face == D)
+            phase_moves[2].push_back(m);
+        if (is_half)
+            phase_moves[3].push_back(m);
+    }
+
+    // Phase 1
+    BuildDistTable(eo_dist, eo_coord_num, std::vector<int>(1, 0), phase_moves[0], [&](int coord, int m) {
+        RubikCube3Cubie cubie;
+        int parity = 0;
+        for (int i = 0; i < EDGE_NUM - 1; i ++) {
+            cubie.eo[i] = (coord >> i) & 1;
+            parity ^= cubie.eo[i];
+        }
+        cubie.eo[EDGE_NUM - 1] = parity;
+        cubie.Move(phase_moves[0][m]);
+        return GetEOCoord(cubie);
+    });
+
+    // Phase 2
+    const int g2_move_num = phase_moves[1].size();
+    co_moves.resize(co_coord_num * g2_move_num);
+    for (int coord = 0; coord < co_coord_num; coord ++) {
+        RubikCube3Cubie cubie;
+        int twist = 0;
+        for (int i = 0, c = coord; i < CORNER_NUM - 1; i ++, c /= 3) {
+            cubie.co[i] = c % 3;
+            twist += cubie.co[i];
+        }
+        cubie.co[CORNER_NUM - 1] = (3 - twist % 3) % 3;
+        for (int m = 0; m < g2_move_num; m ++) {
+            RubikCube3Cubie next = cubie;
+            next.Move(phase_moves[1][m]);
+            co_moves[coord * g2_move_num + m] = GetCOCoord(next);
+        }
+    }
+
+    std::vector<int> slice_masks;
+    slice_ranks.assign(1 << EDGE_NUM, -1);
+    for (int mask = 0; mask < (1 << EDGE_NUM); mask ++) {
+        if (__builtin_popcount(mask) == 4) {
+            slice_ranks[mask] = slice_masks.size();
+            slice_masks.push_back(mask);
+        }
+    }
+    assert(slice_masks.size() == slice_coord_num);
+
+    slice_moves.resize(slice_coord_num * g2_move_num);
+    for (int coord = 0; coord < slice_coord_num; coord ++)
+        for (int m = 0; m < g2_move_num; m ++)
+            slice_moves[coord * g2_move_num + m] = slice_ranks[GetMaskAfter(
+                RubikCube3Cubie::GetMoveCubie(phase_moves[1][m]), slice_masks[coord], EDGE_NUM)];
+
+    BuildDistTable(co_dist, co_coord_num, std::vector<int>(1, 0), phase_moves[1], [&](int coord, int m) {
+        return co_moves[coord * g2_move_num + m];
+    });
+    BuildDistTable(slice_dist, slice_coord_num,
+                   std::vector<int>(1, slice_ranks[GetSliceMask(RubikCube3Cubie())]), phase_moves[1],
+                   [&](int coord, int m) {
+        return slice_moves[coord * g2_move_num + m];
+    });
+
+    edge_pos_moves.resize(EDGE_NUM * g2_move_num);
+    for (int m = 0; m < g2_move_num; m ++) {
+        const RubikCube3Cubie &move = RubikCube3Cubie::GetMoveCubie(phase_moves[1][m]);
+        for (int i = 0; i < EDGE_NUM; i ++)
+            edge_pos_moves[move.ep[i] * g2_move_num + m] = i;
+    }
+
+    // E-slice edges are alike for the goal, so one table serves each of them
+    std::vector<int> solved_co_edge_coords;
+    for (int i = FR; i < EDGE_NUM; i ++)
+        solved_co_edge_coords.push_back(i);
+    BuildDistTable(co_edge_dist, co_coord_num * EDGE_NUM, solved_co_edge_coords, phase_moves[1],
+                   [&](int coord, int m) {
+        return co_moves[(coord / EDGE_NUM) * g2_move_num + m] * EDGE_NUM +
+               edge_pos_moves[(coord % EDGE_NUM) * g2_move_num + m];
+    });
+
+    // Phase 3: G3 corner group is generated by half turns from the solved corners
+    std::vector<int> group_ranks;
+    corner_group.push_back(RubikCube3Cubie());
+    group_ranks.push_back(0);
+    for (int i = 0; i < corner_group.size(); i ++) {
+        for (int m = 0; m < phase_moves[3].size(); m ++) {
+            RubikCube3Cubie next = corner_group[i];
+            next.Move(phase_moves[3][m]);
+            int rank = GetCornerRank(next);
+            if (std::find(group_ranks.begin(), group_ranks.end(), rank) == group_ranks.end()) {
+                corner_group.push_back(next);
+                group_ranks.push_back(rank);
+            }
+        }
+    }
+    assert(corner_group.size() == tetrad_coord_num);
+
+    const int g3_move_num = phase_moves[2].size();
+    std::vector<RubikCube3Cubie> coset_cubies(1, RubikCube3Cubie());
+    std::vector<int> coset_ranks(1, GetCanonicalCornerRank(*this, coset_cubies[0]));
+    for (int i = 0; i < coset_cubies.size(); i ++) {
+        for (int m = 0; m < g3_move_num; m ++) {
+            RubikCube3Cubie next = coset_cubies[i];
+            next.Move(phase_moves[2][m]);
+            int rank = GetCanonicalCornerRank(*this, next);
+            if (std::find(coset_ranks.begin(), coset_ranks.end(), rank) == coset_ranks.end()) {
+                coset_cubies.push_back(next);
+                coset_ranks.push_back(rank);
+            }
+        }
+    }
+    assert(coset_cubies.size() == corner_coset_num);
+    corner_coset_ranks = coset_ranks;
+    std::sort(corner_coset_ranks.begin(), corner_coset_ranks.end());
+
+    corner_coset_moves.resize(corner_coset_num * g3_move_num);
+    for (int i = 0; i < coset_cubies.size(); i ++) {
+        int coset = GetCornerCoset(*this, coset_cubies[i]);
+        for (int m = 0; m < g3_move_num; m ++) {
+            RubikCube3Cubie next = coset_cubies[i];
+            next.Move(phase_moves[2][m]);
+            corner_coset_moves[coset * g3_move_num + m] = GetCornerCoset(*this, next);
+        }
+    }
+
+    std::vector<int> m_edge_masks;
+    m_edge_ranks.assign(1 << FR, -1);
+    for (int mask = 0; mask < (1 << FR); mask ++) {
+        if (__builtin_popcount(mask) == 4) {
+            m_edge_ranks[mask] = m_edge_masks.size();
+            m_edge_masks.push_back(mask);
+        }
+    }
+    assert(m_edge_masks.size() == m_edge_coord_num);
+
+    const int solved_g3_coord = GetCornerCoset(*this, RubikCube3Cubie()) * m_edge_coord_num +
+                                m_edge_ranks[GetMEdgeMask(RubikCube3Cubie())];
+    BuildDistTable(g3_dist, corner_coset_num * m_edge_coord_num, std::vector<int>(1, solved_g3_coord),
+                   phase_moves[2], [&](int coord, int m) {
+        int next_mask = GetMaskAfter(RubikCube3Cubie::GetMoveCubie(phase_moves[2][m]),
+                                     m_edge_masks[coord % m_edge_coord_num], FR);
+        return corner_coset_moves[(coord / m_edge_coord_num) * g3_move_num + m] * m_edge_coord_num +
+               m_edge_ranks[next_mask];
+    });
+
+    // Phase 4
+    const int g4_move_num = phase_moves[3].size();
+    tetrad_idxs.assign(24 * 24, -1);
+    for (int i = 0; i < corner_group.size(); i ++)
+        tetrad_idxs[GetTetradRanks(corner_group[i])] = i;
+
+    tetrad_moves.resize(tetrad_coord_num * g4_move_num);
+    for (int i = 0; i < corner_group.size(); i ++) {
+        for (int m = 0; m < g4_move_num; m ++) {
+            RubikCube3Cubie next = corner_group[i];
+            next.Move(phase_moves[3][m]);
+            tetrad_moves[i * g4_move_num + m] = tetrad_idxs[GetTetradRanks(next)];
+        }
+    }
+
+    for (int s = 0; s < 3; s ++) {
+        slice_perm_moves[s].resize(slice_perm_coord_num * g4_move_num);
+        int perm[4] = {0, 1, 2, 3};
+        do {
+            RubikCube3Cubie cubie;
+            for (int i = 0; i < 4; i ++)
+                cubie.ep[slice_edges[s][i]] = slice_edges[s][perm[i]];
+            for (int m = 0; m < g4_move_num; m ++) {
+                RubikCube3Cubie next = cubie;
+                next.Move(phase_moves[3][m]);
+                slice_perm_moves[s][GetPermRank(perm, 4) * g4_move_num + m] = GetSlicePermRank(next, s);
+            }
+        } while (std::next_permutation(perm, perm + 4));
+
+        BuildDistTable(corner_slice_dist[s], tetrad_coord_num * slice_perm_coord_num, std::vector<int>(1, 0),
+                       phase_moves[3],
+                       [&](int coord, int m) {
+            return tetrad_moves[(coord / 24) * g4_move_num + m] * 24 +
+                   slice_perm_moves[s][(coord % 24) * g4_move_num + m];
+        });
+    }
+
+    BuildDistTable(slice_perm_dist, 24 * 24 * 24, std::vector<int>(1, 0), phase_moves[3], [&](int coord, int m) {
+        int next_coord = 0;
+        for (int s = 0; s < 3; s ++) {
+            int shift = (s == 0)? 24 * 24: (s == 1)? 24: 1;
+            next_coord = next_coord * 24 + slice_perm_moves[s][((coord / shift) % 24) * g4_move_num + m];
+        }
+        return next_coord;
+    });
+}
+
+
+static const ThistlethwaiteTables& GetThistlethwaiteTables() {
+    static const ThistlethwaiteTables tables;
+    return tables;
+}
+
+
+// Depth-first search bounded by the cost of the moves and by depth, pruned by the admissible
+// heuristic of the phase state times the cheapest move cost. next_bound gets the least
+// estimated cost over the bound. Moves are appended to path, as indices of phase_moves.
+template <typename PhaseState>
+static bool SearchPhase(const ThistlethwaiteTables& tables, const PhaseState& state,
+                        const double& cost, const double& bound, const int& depth, const int& last_face,
+                        const std::vector<int>& phase_moves, const std::vector<double>& move_costs,
+                        const double& min_cost, double& next_bound, std::vector<int>& path) {
+    int h = state.GetHeuristic(tables);
+    if (h == 0)
+        return true;
+    if (h > depth)
+        return false;
+    const double estimated_cost = cost + h * min_cost;
+    if (estimated_cost > bound + cost_epsilon) {
+        next_bound = std::min(next_bound, estimated_cost);
+        return false;
+    }
+
+    for (int i = 0; i < phase_moves.size(); i ++) {
+        int face = phase_moves[i] / 3;
+        // Skip turning the same face twice, and keep opposite faces in one order
+        if (face == last_face || (last_face >= 0 && face == opposite_faces[last_face] && face < last_face))
+            continue;
+
+        path.push_back(i);
+        if (SearchPhase(tables, state.Move(tables, i), cost + move_costs[i], bound, depth - 1, face,
+                        phase_moves, move_costs, min_cost, next_bound, path))
+            return true;
+        path.pop_back();
+    }
+    return false;
+}
+
+
+// Iterative deepening by cost from the heuristic up to max_depth moves.
+// Returns false if no path of up to max_depth moves reaches the phase's goal.
+template <typename PhaseState>
+static bool SearchPhase(const ThistlethwaiteTables& tables, const PhaseState& state, const int& max_depth,
+                        const std::vector<int>& phase_moves, const std::vector<double>& move_costs,
+                        std::vector<int>& path) {
+    const double min_cost = *std::min_element(move_costs.begin(), move_costs.end());
+    const double max_bound = max_depth * *std::max_element(move_costs.begin(), move_costs.end());
+    path.clear();
+    for (double bound = state.GetHeuristic(tables) * min_cost; bound <= max_bound + cost_epsilon; ) {
+        double next_bound = std::numeric_limits<double>::infinity();
+        if (SearchPhase(tables, state, 0, bound, max_depth, -1, phase_moves, move_costs, min_cost, next_bound, path))
+            return true;
+        bound = next_bound;
+    }
+    return false;
+}
+
+
+void RubikCube3ThistlethwaiteSolver::GetPhaseMoveCosts(const std::vector<int>& phase_moves,
+                                                       std::vector<double>& move_costs) {
+    move_costs.resize(phase_moves.size());
+    for (int i = 0; i < phase_moves.size(); i ++)
+        move_costs[i] = GetMoveCost((CUBE_FACE)(phase_moves[i] / 3), phase_moves[i] % 3);
+}
+
+
+std::string RubikCube3ThistlethwaiteSolver::DoSolve() {
+    std::string moves;
+
+    if (!IsInG1())
+        moves += SolveG1() + " ";
+
+    if (!IsInG2())
+        moves += SolveG2() + " ";
+
+    if (!IsInG3())
+        moves += SolveG3() + " ";
+
+    if (!IsInG4())
+        moves += SolveG4();
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Phase 1: G0 -> G1
+bool RubikCube3ThistlethwaiteSolver::IsInG1() {
+    return GetEOCoord(RubikCube3Cubie(cube_)) == 0;
+}
+
+
+std::string RubikCube3ThistlethwaiteSolver::SolveG1() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    const std::vector<int> &phase_moves = tables.phase_moves[0];
+    std::string moves;
+
+    // Exact distance table, follow the cheapest move which decreases the distance
+    RubikCube3Cubie cubie(cube_);
+    GetPhaseMoveCosts(phase_moves, move_costs_);
+    while (tables.eo_dist[GetEOCoord(cubie)] > 0) {
+        int dist = tables.eo_dist[GetEOCoord(cubie)];
+        int best_move = -1;
+        for (int i = 0; i < phase_moves.size(); i ++) {
+            RubikCube3Cubie next = cubie;
+            next.Move(phase_moves[i]);
+            if (tables.eo_dist[GetEOCoord(next)] < dist && (best_move < 0 || move_costs_[i] < move_costs_[best_move]))
+                best_move = i;
+        }
+        CheckProgress(dist != unknown_dist && best_move >= 0, "Thistlethwaite phase 1");
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(phase_moves[best_move]));
+        cubie.Move(phase_moves[best_move]);
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Phase 2: G1 -> G2
+bool RubikCube3ThistlethwaiteSolver::IsInG2() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    RubikCube3Cubie cubie(cube_);
+    return GetEOCoord(cubie) == 0 && G2State(tables, cubie).GetHeuristic(tables) == 0;
+}
+
+
+std::string RubikCube3ThistlethwaiteSolver::SolveG2() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    const std::vector<int> &phase_moves = tables.phase_moves[1];
+    std::string moves;
+
+    G2State state(tables, RubikCube3Cubie(cube_));
+    GetPhaseMoveCosts(phase_moves, move_costs_);
+    CheckProgress(SearchPhase(tables, state, max_phase_depth[1], phase_moves, move_costs_, path_),
+                  "Thistlethwaite phase 2");
+
+    for (int i = 0; i < path_.size(); i ++)
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(phase_moves[path_[i]]));
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Phase 3: G2 -> G3
+bool RubikCube3ThistlethwaiteSolver::IsInG3() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    RubikCube3Cubie cubie(cube_);
+    return IsInG2() && GetCornerCoset(tables, cubie) == GetCornerCoset(tables, RubikCube3Cubie()) &&
+           GetMEdgeMask(cubie) == GetMEdgeMask(RubikCube3Cubie());
+}
+
+
+std::string RubikCube3ThistlethwaiteSolver::SolveG3() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    const std::vector<int> &phase_moves = tables.phase_moves[2];
+    std::string moves;
+
+    // Exact distance table, follow the cheapest move which decreases the distance
+    RubikCube3Cubie cubie(cube_);
+    int coset = GetCornerCoset(tables, cubie);
+    int mask = GetMEdgeMask(cubie);
+    GetPhaseMoveCosts(phase_moves, move_costs_);
+    while (tables.g3_dist[coset * m_edge_coord_num + tables.m_edge_ranks[mask]] > 0) {
+        int dist = tables.g3_dist[coset * m_edge_coord_num + tables.m_edge_ranks[mask]];
+        int best_move = -1, best_coset = 0, best_mask = 0;
+        for (int i = 0; i < phase_moves.size(); i ++) {
+            int next_coset = tables.corner_coset_moves[coset * phase_moves.size() + i];
+            int next_mask = GetMaskAfter(RubikCube3Cubie::GetMoveCubie(phase_moves[i]), mask, FR);
+            if (tables.g3_dist[next_coset * m_edge_coord_num + tables.m_edge_ranks[next_mask]] < dist &&
+                (best_move < 0 || move_costs_[i] < move_costs_[best_move])) {
+                best_move = i;
+                best_coset = next_coset;
+                best_mask = next_mask;
+            }
+        }
+        CheckProgress(dist != unknown_dist && best_move >= 0, "Thistlethwaite phase 3");
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(phase_moves[best_move]));
+        coset = best_coset;
+        mask = best_mask;
+    }
+
+    return cube_.CompressMoves(moves);
+}
+
+
+// Phase 4: G3 -> G4
+bool RubikCube3ThistlethwaiteSolver::IsInG4() {
+    return RubikCube3Cubie(cube_).IsSolved();
+}
+
+
+std::string RubikCube3ThistlethwaiteSolver::SolveG4() {
+    const ThistlethwaiteTables &tables = GetThistlethwaiteTables();
+    const std::vector<int> &phase_moves = tables.phase_moves[3];
+    std::string moves;
+
+    G4State state(tables, RubikCube3Cubie(cube_));
+    GetPhaseMoveCosts(phase_moves, move_costs_);
+    CheckProgress(SearchPhase(tables, state, max_phase_depth[3], phase_moves, move_costs_, path_),
+                  "Thistlethwaite phase 4");
+
+    for (int i = 0; i < path_.size(); i ++)
+        moves += MoveCube(RubikCube3Cubie::GetMoveString(phase_moves[path_[i]]));
+
+    return cube_.CompressMoves(moves);
+}
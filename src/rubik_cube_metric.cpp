@@ -0,0 +1,283 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_metric.hpp"
+#include "rubik_cube_permutation.hpp"
+
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <cassert>
+
+using namespace rb;
+
+static const int metric_move_num = UNKNOWN_SLICE + 3;     // "ULFRBDulfrbdXYZxyz"
+static const int orientation_num = 24;
+static const int rotation_move_num = 9;                   // x, y and z by every turn
+// Every move char turns its own layers on 5x5x5, so moves are told apart on it
+static const int orientation_dim = 5;
+
+// Axis of every move char: L-R, U-D or F-B
+static const int move_axes[metric_move_num] = {1, 0, 2, 0, 2, 1, 1, 0, 2, 0, 2, 1, 0, 1, 2, 0, 1, 2};
+
+static const char* turn_suffixes[3] = {"", "2", "'"};
+
+
+static std::string GetMoveString(const int& move_char_idx, const int& turn) {
+    return std::string(1, move_chars[move_char_idx]) + turn_suffixes[turn];
+}
+
+
+// The 24 orientations of the whole cube, how x, y and z rotations change them,
+// and which move turns the same layer of the cube in every orientation
+struct OrientationTables {
+    OrientationTables() {
+        std::vector<RubikCubePermutation> perms(1, RubikCubePermutation(orientation_dim));
+        for (int o = 0; o < perms.size(); o ++) {
+            for (int r = 0; r < rotation_move_num; r ++) {
+                RubikCubePermutation perm = perms[o];
+                perm.Move(GetMoveString(UNKNOWN_SLICE + r / 3, r % 3));
+                int next = 0;
+                while (next < perms.size() && perms[next] != perm)
+                    next ++;
+                if (next == perms.size())
+                    perms.push_back(perm);
+                next_orientations[o][r] = next;
+            }
+        }
+        assert(perms.size() == orientation_num);
+
+        // After rotating the cube by o, move m of the original orientation is the
+        // move m' with o m' = m o
+        for (int o = 0; o < orientation_num; o ++) {
+            for (int m = 0; m < metric_move_num * 3; m ++) {
+                RubikCubePermutation moved(GetMoveString(m / 3, m % 3), orientation_dim);
+                moved.Multiply(perms[o]);
+                int mapped = 0;
+                for (; mapped < metric_move_num * 3; mapped ++) {
+                    RubikCubePermutation perm = perms[o];
+                    perm.Move(GetMoveString(mapped / 3, mapped % 3));
+                    if (perm == moved)
+                        break;
+                }
+                assert(mapped < metric_move_num * 3);
+                mapped_moves[o][m] = mapped;
+            }
+        }
+    }
+
+    int next_orientations[orientation_num][rotation_move_num];
+    int mapped_moves[orientation_num][metric_move_num * 3];
+};
+
+
+static const OrientationTables& GetOrientationTables() {
+    static const OrientationTables tables;
+    return tables;
+}
+
+
+RubikCubeMetric::RubikCubeMetric(const MOVE_METRIC& metric/* = HTM*/) {
+    const double face_quarter_cost = 1;
+    const double face_half_cost = (metric == QTM)? 2: 1;
+    const double slice_quarter_cost = (metric == STM)? 1: 2 * face_quarter_cost;
+    const double slice_half_cost = (metric == STM)? 1: 2 * face_half_cost;
+
+    for (int i = 0; i < metric_move_num; i ++) {
+        if (i < UNKNOWN_FACE)
+            SetMoveCost(move_chars[i], face_quarter_cost, face_half_cost);
+        else if (i < UNKNOWN_SLICE)
+            SetMoveCost(move_chars[i], slice_quarter_cost, slice_half_cost);
+        else
+            SetMoveCost(move_chars[i], 0, 0);
+    }
+}
+
+
+void RubikCubeMetric::SetMoveCost(const char& move_char, const double& quarter_cost, const double& half_cost) {
+    SetTurnCost(move_char, 0, quarter_cost);
+    SetTurnCost(move_char, 1, half_cost);
+    SetTurnCost(move_char, 2, quarter_cost);
+}
+
+
+void RubikCubeMetric::SetTurnCost(const char& move_char, const int& turn, const double& cost) {
+    const char *c = std::strchr(move_chars, move_char);
+    assert(c && *c && turn >= 0 && turn < 3 && cost >= 0);
+    costs_[c - move_chars][turn] = cost;
+}
+
+
+double RubikCubeMetric::GetMoveCost(const char& move_char, const int& turn) const {
+    const char *c = std::strchr(move_chars, move_char);
+    assert(c && *c && turn >= 0 && turn < 3);
+    return costs_[c - move_chars][turn];
+}
+
+
+// Move char indices and quarter turns clockwise of every move
+static void ParseMoves(const std::string& moves, std::vector<std::pair<int, int> >& turns) {
+    for (int i = 0; i < moves.length(); i ++) {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        const char *move_char = std::strchr(move_chars, moves[i]);
+        assert(move_char && *move_char);
+
+        int quarter_num = 1;
+        // peek next char
+        if ((i + 1) < moves.length()) {
+            if (moves[i + 1] == '\'' || moves[i + 1] == 'i')
+                quarter_num = 3;
+            else if (moves[i + 1] == '2')
+                quarter_num = 2;
+        }
+        turns.push_back(std::make_pair((int)(move_char - move_chars), quarter_num));
+    }
+}
+
+
+double RubikCubeMetric::GetMovesCost(const std::string& moves) const {
+    std::vector<std::pair<int, int> > turns;
+    ParseMoves(moves, turns);
+
+    double cost = 0;
+    for (int i = 0; i < turns.size(); i ++)
+        cost += costs_[turns[i].first][turns[i].second - 1];
+    return cost;
+}
+
+
+std::string RubikCubeMetric::Reexpress(const std::string& moves) const {
+    const OrientationTables &tables = GetOrientationTables();
+    const double inf_cost = std::numeric_limits<double>::infinity();
+
+    // Merge the turns of every char among the commuting turns along one axis,
+    // a turn cancelled out lets the turns around it merge in turn
+    std::vector<std::pair<int, int> > turns;
+    ParseMoves(moves, turns);
+    std::vector<std::pair<int, int> > merged;
+    for (int i = 0; i < turns.size(); i ++) {
+        const int axis = move_axes[turns[i].first];
+        int j = merged.size() - 1;
+        while (j >= 0 && move_axes[merged[j].first] == axis && merged[j].first != turns[i].first)
+            j --;
+        if (j >= 0 && merged[j].first == turns[i].first) {
+            merged[j].second = (merged[j].second + turns[i].second) % 4;
+            if (merged[j].second == 0)
+                merged.erase(merged.begin() + j);
+        } else {
+            merged.push_back(turns[i]);
+        }
+    }
+
+    // Cheapest way of every move, a single turn or repeated opposite quarter turns
+    double move_costs[metric_move_num * 3];
+    std::string move_strings[metric_move_num * 3];
+    for (int m = 0; m < metric_move_num * 3; m ++) {
+        const int idx = m / 3, turn = m % 3;
+        move_costs[m] = costs_[idx][turn];
+        move_strings[m] = GetMoveString(idx, turn);
+        for (int q = 0; q < 3; q += 2) {
+            // (turn + 1) quarter turns clockwise by quarter turns q
+            const int repeat_num = (q == 0)? (turn + 1): (3 - turn);
+            if (repeat_num * costs_[idx][q] < move_costs[m]) {
+                move_costs[m] = repeat_num * costs_[idx][q];
+                move_strings[m] = GetMoveString(idx, q);
+                for (int k = 1; k < repeat_num; k ++)
+                    move_strings[m] += " " + GetMoveString(idx, q);
+            }
+        }
+    }
+
+    // Cheapest rotations between every two orientations, relaxed until nothing changes
+    double rotation_costs[orientation_num][orientation_num];
+    int rotation_moves[orientation_num][orientation_num];     // first rotation on the way
+    for (int o = 0; o < orientation_num; o ++) {
+        for (int p = 0; p < orientation_num; p ++) {
+            rotation_costs[o][p] = (o == p)? 0: inf_cost;
+            rotation_moves[o][p] = -1;
+        }
+    }
+    for (bool is_changed = true; is_changed; ) {
+        is_changed = false;
+        for (int o = 0; o < orientation_num; o ++) {
+            for (int r = 0; r < rotation_move_num; r ++) {
+                const int next = tables.next_orientations[o][r];
+                const double cost = move_costs[UNKNOWN_SLICE * 3 + r];
+                for (int p = 0; p < orientation_num; p ++) {
+                    if (cost + rotation_costs[next][p] < rotation_costs[o][p]) {
+                        rotation_costs[o][p] = cost + rotation_costs[next][p];
+                        rotation_moves[o][p] = r;
+                        is_changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Cheapest orientation to do every move in, from the orientation after the previous one.
+    // Staying in the same orientation wins ties, so rotations are only added when they pay.
+    // X, Y and Z are off the middle on even cubes, so they are only done as themselves,
+    // in orientations which keep their layer and its direction.
+    std::vector<double> costs(orientation_num, inf_cost);
+    std::vector<double> next_costs(orientation_num);
+    std::vector<unsigned char> prev_orientations(merged.size() * orientation_num);
+    costs[0] = 0;
+    for (int i = 0; i < merged.size(); i ++) {
+        const int move = merged[i].first * 3 + merged[i].second - 1;
+        for (int p = 0; p < orientation_num; p ++) {
+            const bool is_moved_middle = (merged[i].first >= X && merged[i].first <= Z &&
+                                          tables.mapped_moves[p][merged[i].first * 3] != merged[i].first * 3);
+            const double move_cost = is_moved_middle? inf_cost: move_costs[tables.mapped_moves[p][move]];
+            next_costs[p] = costs[p] + move_cost;
+            prev_orientations[i * orientation_num + p] = p;
+            for (int o = 0; o < orientation_num; o ++) {
+                if (costs[o] + rotation_costs[o][p] + move_cost < next_costs[p]) {
+                    next_costs[p] = costs[o] + rotation_costs[o][p] + move_cost;
+                    prev_orientations[i * orientation_num + p] = o;
+                }
+            }
+        }
+        costs.swap(next_costs);
+    }
+
+    // The cube is rotated back in the end, so the moves leave it as the original ones do
+    int orientation = 0;
+    for (int o = 1; o < orientation_num; o ++)
+        if (costs[o] + rotation_costs[o][0] < costs[orientation])
+            orientation = o;
+    std::vector<int> orientations(merged.size() + 2, 0);
+    for (int i = merged.size(); i > 0; i --) {
+        orientations[i] = orientation;
+        orientation = prev_orientations[(i - 1) * orientation_num + orientation];
+    }
+
+    std::string ret_moves;
+    for (int i = 0; i <= merged.size(); i ++) {
+        for (int o = orientations[i]; o != orientations[i + 1]; ) {
+            const int r = rotation_moves[o][orientations[i + 1]];
+            ret_moves += move_strings[UNKNOWN_SLICE * 3 + r] + " ";
+            o = tables.next_orientations[o][r];
+        }
+        if (i == merged.size())
+            break;
+        const int move = merged[i].first * 3 + merged[i].second - 1;
+        ret_moves += move_strings[tables.mapped_moves[orientations[i + 1]][move]] + " ";
+    }
+    if (ret_moves.length())
+        ret_moves.erase(ret_moves.length() - 1);
+    return ret_moves;
+}
@@ -0,0 +1,55 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "rubik_cube.hpp"
+
+#include <string>
+
+
+namespace rb {
+
+enum MOVE_METRIC {
+    QTM = 0,    // quarter turn metric, a half turn costs 2
+    HTM,        // half turn metric, every face turn costs 1
+    STM,        // slice turn metric, every face or inner slice turn costs 1
+};
+
+// Cost of every move of move_chars by its turn: CW, half turn or CCW.
+// The metrics cost an inner slice turn like the two face turns it takes,
+// except STM, and whole cube rotations x, y and z nothing.
+// Any cost can be set afterwards, e.g. for the time a robot takes to do it.
+class RubikCubeMetric {
+  public:
+    explicit RubikCubeMetric(const MOVE_METRIC& metric = HTM);
+
+    void SetMoveCost(const char& move_char, const double& quarter_cost, const double& half_cost);
+    void SetTurnCost(const char& move_char, const int& turn, const double& cost);
+    double GetMoveCost(const char& move_char, const int& turn) const;
+    double GetMovesCost(const std::string& moves) const;
+
+    // The same moves at the least cost: turns along one axis are merged as they commute,
+    // every turn is done as its cheapest equivalent, like R2 as R R, and x, y and z
+    // rotations are inserted where turning other faces saves more than they cost.
+    // The cube ends in the same orientation, rotated back if need be, so the moves
+    // take a RubikCube to the same state as the original ones.
+    std::string Reexpress(const std::string& moves) const;
+
+  private:
+    double costs_[UNKNOWN_SLICE + 3][3];
+};
+
+}
@@ -0,0 +1,311 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_packed.hpp"
+
+#include <cstring>
+#include <cassert>
+
+using namespace rb;
+
+static const char* face_chars = "ULFRBD";
+
+static const int face_num = 6;
+static const int sticker_bits = 3;
+static const uint64_t sticker_mask = 7;
+static const uint64_t sticker_ones = 0x1249249249249249ULL;    // lowest bit of 21 stickers
+static const int word_stickers = 21;
+
+enum FACE_CORNER {
+    UL = 4,
+    UR,
+    DR,
+    DL,
+};
+
+struct SliceInfo {
+    int face_idx;     // face index
+    int start_pos;    // start position
+    int dir;          // index increase or decrease
+    bool is_row;      // indices are along the row or col
+};
+
+
+// Same slices as RubikCube, so both turn stickers identically
+static const SliceInfo slice_info[3][4] = {
+    {{0, UL,  1, false}, {2, UL,  1, false}, {5, UL,  1, false}, {4, DR, -1, false}},   // L, l, X, r, R
+    {{1, UL,  1,  true}, {2, UL,  1,  true}, {3, UL,  1,  true}, {4, UL,  1,  true}},   // U, u, Y, d, D
+    {{0, UR, -1,  true}, {1, UL,  1, false}, {5, DL,  1,  true}, {3, DR, -1, false}},   // F, f, Z, b, B
+};
+
+
+static inline int GetSliceInfoIndex(int move_char_idx) {
+    switch (move_char_idx) {
+      case L: case l: case X: case r: case R:
+        return 0;
+      case U: case u: case Y: case d: case D:
+        return 1;
+      case F: case f: case Z: case b: case B:
+        return 2;
+      default:
+        assert(0);
+    }
+}
+
+
+inline uint64_t ReverseStickers(uint64_t line, const int& num) {
+    uint64_t reversed = 0;
+    for (int i = 0; i < num; i ++) {
+        reversed = (reversed << sticker_bits) | (line & sticker_mask);
+        line >>= sticker_bits;
+    }
+    return reversed;
+}
+
+
+RubikCubePacked::RubikCubePacked(int dim/* = 5*/):
+    dim_(dim), piece_num_(dim * dim) {
+    assert(dim >= 2 && dim <= max_dim);
+
+    words_.assign((piece_num_ * face_num * sticker_bits + 63) / 64, 0);
+    for (int i = 0; i < face_num; i ++)
+        for (int j = 0; j < piece_num_; j ++)
+            SetBits((i * piece_num_ + j) * sticker_bits, sticker_bits, i);
+}
+
+
+RubikCubePacked::RubikCubePacked(const std::string& faces, int dim):
+    dim_(dim), piece_num_(dim * dim) {
+    assert(dim >= 2 && dim <= max_dim);
+    assert(faces.length() == piece_num_ * face_num);
+
+    words_.assign((piece_num_ * face_num * sticker_bits + 63) / 64, 0);
+    for (int i = 0; i < piece_num_ * face_num; i ++) {
+        CUBE_FACE face = CvtFaceCharToFace(faces[i]);
+        assert(face != UNKNOWN_FACE);
+        SetBits(i * sticker_bits, sticker_bits, face);
+    }
+}
+
+
+uint64_t RubikCubePacked::GetBits(const int& pos, const int& len) const {
+    const int word_idx = pos >> 6;
+    const int shift = pos & 63;
+    uint64_t bits = words_[word_idx] >> shift;
+    if (shift + len > 64)
+        bits |= words_[word_idx + 1] << (64 - shift);
+    return bits & (((uint64_t)1 << len) - 1);
+}
+
+
+void RubikCubePacked::SetBits(const int& pos, const int& len, const uint64_t& bits) {
+    const uint64_t mask = ((uint64_t)1 << len) - 1;
+    const int word_idx = pos >> 6;
+    const int shift = pos & 63;
+    words_[word_idx] = (words_[word_idx] & ~(mask << shift)) | (bits << shift);
+    if (shift + len > 64)
+        words_[word_idx + 1] = (words_[word_idx + 1] & ~(mask >> (64 - shift))) | (bits >> (64 - shift));
+}
+
+
+// dim_ stickers from sticker index start, step apart, the first one in the lowest bits.
+// Rows (step 1 or -1) are a single read, columns are gathered one sticker at a time.
+uint64_t RubikCubePacked::GetLine(const int& start, const int& step) const {
+    if (step == 1)
+        return GetBits(start * sticker_bits, dim_ * sticker_bits);
+    if (step == -1)
+        return ReverseStickers(GetBits((start - dim_ + 1) * sticker_bits, dim_ * sticker_bits), dim_);
+
+    uint64_t line = 0;
+    for (int i = 0; i < dim_; i ++)
+        line |= GetBits((start + i * step) * sticker_bits, sticker_bits) << (i * sticker_bits);
+    return line;
+}
+
+
+void RubikCubePacked::SetLine(const int& start, const int& step, const uint64_t& line) {
+    if (step == 1) {
+        SetBits(start * sticker_bits, dim_ * sticker_bits, line);
+    } else if (step == -1) {
+        SetBits((start - dim_ + 1) * sticker_bits, dim_ * sticker_bits, ReverseStickers(line, dim_));
+    } else {
+        for (int i = 0; i < dim_; i ++)
+            SetBits((start + i * step) * sticker_bits, sticker_bits, (line >> (i * sticker_bits)) & sticker_mask);
+    }
+}
+
+
+void RubikCubePacked::RotateFace(const CUBE_FACE& rot_face, const ROTATE_DIR& dir) {
+    assert(rot_face < UNKNOWN_FACE);
+
+    const int face_start = rot_face * piece_num_;
+    uint64_t rows[max_dim];
+    for (int r = 0; r < dim_; r ++)
+        rows[r] = GetLine(face_start + r * dim_, 1);
+
+    // CW: new[i][j] = old[dim - 1 - j][i], CCW: new[i][j] = old[j][dim - 1 - i]
+    for (int i = 0; i < dim_; i ++) {
+        uint64_t row = 0;
+        for (int j = 0; j < dim_; j ++) {
+            uint64_t sticker = (dir == CW)? (rows[dim_ - 1 - j] >> (i * sticker_bits)):
+                                            (rows[j] >> ((dim_ - 1 - i) * sticker_bits));
+            row |= (sticker & sticker_mask) << (j * sticker_bits);
+        }
+        SetLine(face_start + i * dim_, 1, row);
+    }
+
+    int slice_info_idx = GetSliceInfoIndex(rot_face);
+    int slice_offset = (rot_face == F || rot_face == R || rot_face == D)? (dim_ - 1): 0;
+    ROTATE_DIR slice_dir = (ROTATE_DIR)((rot_face == L || rot_face == D || rot_face == B)? (CCW - dir): dir);
+
+    DoRotateSlice(slice_info_idx, slice_dir, slice_offset);
+}
+
+
+void RubikCubePacked::RotateSlice(const CUBE_SLICE& rot_slice, const ROTATE_DIR& dir) {
+    assert(dim_ > 2);     // 2x2x2 has no inner slices
+
+    int slice_info_idx = GetSliceInfoIndex(rot_slice);
+    ROTATE_DIR slice_dir = (ROTATE_DIR)((rot_slice == l || rot_slice == d || rot_slice == b)? (CCW - dir): dir);
+    int slice_offset = 0;
+    switch (rot_slice) {
+        case b: case l: case u:
+            slice_offset = 1;
+            break;
+        case X: case Y: case Z:
+            slice_offset = dim_ >> 1;
+            break;
+        case f: case r: case d:
+            slice_offset = dim_ - 2;
+            break;
+        default:
+            assert(0);
+    }
+
+    DoRotateSlice(slice_info_idx, slice_dir, slice_offset);
+}
+
+
+void RubikCubePacked::DoRotateSlice(const int& slice_info_idx, const ROTATE_DIR& dir, const int& offset) {
+    const SliceInfo (&si)[4] = slice_info[slice_info_idx];
+    int starts[4];
+    int steps[4];
+    uint64_t lines[4];
+    for (int i = 0; i < 4; i ++) {
+        const int offset_step = offset * ((si[i].is_row)? dim_: 1);
+        int start_idx = 0;
+        switch (si[i].start_pos) {
+            case UL:
+                start_idx = offset_step;
+                break;
+            case UR:
+                start_idx = (dim_ - 1) + offset_step;
+                break;
+            case DL:
+                start_idx = dim_ * (dim_ - 1) - offset_step;
+                break;
+            case DR:
+                start_idx = (piece_num_ - 1) - offset_step;
+                break;
+            default:
+                assert(0);
+        }
+        starts[i] = si[i].face_idx * piece_num_ + start_idx;
+        steps[i] = si[i].dir * ((si[i].is_row)? 1: dim_);
+        lines[i] = GetLine(starts[i], steps[i]);
+    }
+
+    // CW moves every line one face back in slice_info order, CCW one face forward
+    const int src_step = (dir == CW)? 1: 3;
+    for (int i = 0; i < 4; i ++)
+        SetLine(starts[i], steps[i], lines[(i + src_step) % 4]);
+}
+
+
+// x, y and z turn the whole cube like R, U and F turn their layers: both outer faces
+// and every inner layer in between.
+void RubikCubePacked::RotateCube(const int& rotation, const ROTATE_DIR& dir) {
+    static const CUBE_FACE turn_faces[3] = {R, U, F};
+    static const CUBE_FACE opposite_faces[3] = {L, D, B};
+
+    const CUBE_FACE face = turn_faces[rotation];
+    RotateFace(face, dir);
+    RotateFace(opposite_faces[rotation], (ROTATE_DIR)(CCW - dir));
+
+    const int slice_info_idx = GetSliceInfoIndex(face);
+    for (int offset = 1; offset < dim_ - 1; offset ++)
+        DoRotateSlice(slice_info_idx, dir, offset);
+}
+
+
+void RubikCubePacked::Move(const std::string& moves) {
+    for (int i = 0; i < moves.length(); i ++)
+    {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        const char *move_char = std::strchr(move_chars, moves[i]);
+        assert(move_char);
+        int move_char_idx = move_char - move_chars;
+
+        int move_cnt = 1;
+        ROTATE_DIR rot_dir = CW;
+        // peek next char
+        if ((i + 1) < moves.length())
+        {
+            if (moves[i + 1] == '\'' || moves[i + 1] == 'i')
+                rot_dir = CCW;
+            else if (moves[i + 1] == '2')
+                move_cnt = 2;
+        }
+
+        while (move_cnt--) {
+            if (move_char_idx < UNKNOWN_FACE)
+                RotateFace((CUBE_FACE)move_char_idx, rot_dir);
+            else if (move_char_idx < UNKNOWN_SLICE)
+                RotateSlice((CUBE_SLICE)move_char_idx, rot_dir);
+            else
+                RotateCube(move_char_idx - UNKNOWN_SLICE, rot_dir);
+        }
+    }
+}
+
+
+bool RubikCubePacked::IsSolved() const {
+    // Compare up to 21 stickers at a time with the first sticker of the face repeated
+    for (int i = 0; i < face_num; i ++) {
+        const int face_start = i * piece_num_;
+        const uint64_t face_bits = GetBits(face_start * sticker_bits, sticker_bits) * sticker_ones;
+        for (int j = 0; j < piece_num_; j += word_stickers) {
+            const int len = ((piece_num_ - j < word_stickers)? (piece_num_ - j): word_stickers) * sticker_bits;
+            if (GetBits((face_start + j) * sticker_bits, len) != (face_bits & (((uint64_t)1 << len) - 1)))
+                return false;
+        }
+    }
+    return true;
+}
+
+
+std::string RubikCubePacked::GetCubeString() const {
+    std::string cube_string(piece_num_ * face_num, ' ');
+    for (int i = 0; i < piece_num_ * face_num; i ++)
+        cube_string[i] = face_chars[GetBits(i * sticker_bits, sticker_bits)];
+    return cube_string;
+}
+
+
+char RubikCubePacked::GetPieceChar(const CUBE_FACE& cube_face, const int& row, const int& col) const {
+    return face_chars[GetBits((((int)cube_face * dim_ + row) * dim_ + col) * sticker_bits, sticker_bits)];
+}
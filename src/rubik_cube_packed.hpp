@@ -0,0 +1,68 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "rubik_cube.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+namespace rb {
+
+// Sticker state of a big cube at 3 bits per sticker, in the same face order and
+// move notation as RubikCube. A 5x5x5 takes 64 bytes instead of 151, a 7x7x7
+// 112 bytes instead of 295.
+//
+// Stickers are packed row by row, so a row of up to 21 stickers is read and
+// written as a single word when a slice turn moves it to another face.
+class RubikCubePacked {
+  public:
+    static const int max_dim = 21;
+
+    RubikCubePacked(int dim = 5);
+    // faces holds the face char of every sticker, as RubikCube::GetCubeString() returns
+    RubikCubePacked(const std::string& faces, int dim);
+
+    bool operator==(const RubikCubePacked& other) const { return dim_ == other.dim_ && words_ == other.words_; }
+    bool operator!=(const RubikCubePacked& other) const { return !(*this == other); }
+
+    bool IsSolved() const;
+    std::string GetCubeString() const;
+    char GetPieceChar(const CUBE_FACE& cube_face, const int& row, const int& col) const;
+    int GetDim() const { return dim_; }
+    size_t GetByteNum() const { return words_.size() * sizeof(uint64_t); }
+
+    void Move(const std::string& moves);
+
+  private:
+    uint64_t GetBits(const int& pos, const int& len) const;
+    void SetBits(const int& pos, const int& len, const uint64_t& bits);
+    uint64_t GetLine(const int& start, const int& step) const;
+    void SetLine(const int& start, const int& step, const uint64_t& line);
+
+    void RotateFace(const CUBE_FACE& rot_face, const ROTATE_DIR& dir);
+    void RotateSlice(const CUBE_SLICE& rot_slice, const ROTATE_DIR& dir);
+    void RotateCube(const int& rotation, const ROTATE_DIR& dir);
+    void DoRotateSlice(const int& slice_info_idx, const ROTATE_DIR& dir, const int& offset);
+
+    int dim_;
+    int piece_num_;
+    std::vector<uint64_t> words_;
+};
+
+}
@@ -0,0 +1,439 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_permutation.hpp"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+using namespace rb;
+
+static const int face_num = 6;
+static const int min_dim = 2;
+static const int max_dim = 5;
+static const int move_char_num = 18;     // "ULFRBDulfrbdXYZxyz"
+static const int max_cached_num = 4096;  // per dim and thread, the cache restarts when full
+
+// Moves turning each layer along the L-R, U-D and F-B axes, from the L, U and F side
+static const char* axis_move_chars[3] = {"LlXrR", "UuYdD", "FfZbB"};
+// Axis each face is perpendicular to, and whether it's on the far side of it
+static const int face_axes[face_num] = {1, 0, 2, 0, 2, 1};
+static const bool is_far_faces[face_num] = {false, false, false, true, true, true};
+
+static const char* piece_type_names[UNKNOWN_PIECE] = {"corners", "edges", "centers"};
+
+
+const unsigned char* RubikCubePermutation::GetMovePermutation(const int& dim, const int& move_char_idx,
+                                                             const int& turn, const unsigned char** face_perm/* = NULL*/) {
+    // Permutations of every single move for every dim, built once
+    struct MovePermutations {
+        MovePermutations() {
+            for (int dim = min_dim; dim <= max_dim; dim ++)
+                for (int m = 0; m < move_char_num; m ++)
+                    if (dim > 2 || m < UNKNOWN_FACE || m >= UNKNOWN_SLICE)    // 2x2x2 has no inner slices
+                        BuildMovePermutation(dim, m, perms[dim - min_dim][m], face_perms[dim - min_dim][m]);
+        }
+        unsigned char perms[max_dim - min_dim + 1][move_char_num][3][max_facelet_num];
+        unsigned char face_perms[max_dim - min_dim + 1][move_char_num][3][face_num];
+    };
+    static const MovePermutations move_perms;
+
+    if (face_perm)
+        *face_perm = move_perms.face_perms[dim - min_dim][move_char_idx][turn];
+    return move_perms.perms[dim - min_dim][move_char_idx][turn];
+}
+
+
+// Label every facelet by its index and let RubikCube move the labels,
+// turn_perms gets the CW, half turn and CCW permutations, turn_face_perms the faces
+// they come from, as RubikCube tracks where every face went in its face mappings.
+void RubikCubePermutation::BuildMovePermutation(const int& dim, const int& move_char_idx,
+                                                unsigned char (*turn_perms)[max_facelet_num],
+                                                unsigned char (*turn_face_perms)[UNKNOWN_FACE]) {
+    const int facelet_num = face_num * dim * dim;
+    RubikCube cube(dim);
+    for (int i = 0; i < facelet_num; i ++)
+        cube.faces_[i] = i + 1;
+
+    for (int t = 0; t < 3; t ++) {
+        cube.Move(std::string(1, move_chars[move_char_idx]));
+        for (int i = 0; i < facelet_num; i ++)
+            turn_perms[t][i] = (unsigned char)cube.faces_[i] - 1;
+        for (int f = 0; f < face_num; f ++)
+            turn_face_perms[t][(int)cube.mapped_faces_[f]] = f;
+    }
+}
+
+
+const RubikCubePermutation::PieceLayout& RubikCubePermutation::GetPieceLayout(const int& dim) {
+    struct PieceLayouts {
+        PieceLayouts() {
+            for (int dim = min_dim; dim <= max_dim; dim ++)
+                BuildPieceLayout(dim, layouts[dim - min_dim]);
+        }
+        PieceLayout layouts[max_dim - min_dim + 1];
+    };
+    static const PieceLayouts piece_layouts;
+
+    return piece_layouts.layouts[dim - min_dim];
+}
+
+
+// Locate every facelet by the layers it belongs to along the three axes,
+// facelets in the same three layers are on the same piece.
+void RubikCubePermutation::BuildPieceLayout(const int& dim, PieceLayout& layout) {
+    const int piece_num = dim * dim;
+    const int facelet_num = face_num * piece_num;
+    const int move_layers[5] = {0, 1, dim >> 1, dim - 2, dim - 1};
+
+    int position_pieces[max_dim * max_dim * max_dim];
+    std::memset(position_pieces, -1, sizeof(position_pieces));
+    layout.piece_num = 0;
+
+    for (int i = 0; i < facelet_num; i ++) {
+        const int face = i / piece_num;
+        int layers[3];
+        layers[face_axes[face]] = is_far_faces[face]? (dim - 1): 0;
+
+        // A layer turn moves every facelet of the layer which isn't on the turning face
+        for (int axis = 0; axis < 3; axis ++) {
+            if (axis == face_axes[face])
+                continue;
+            layers[axis] = -1;
+            for (int k = 0; k < 5 && layers[axis] < 0; k ++) {
+                if (dim == 2 && k > 0 && k < 4)
+                    continue;
+                int move_char_idx = std::strchr(move_chars, axis_move_chars[axis][k]) - move_chars;
+                if (GetMovePermutation(dim, move_char_idx, 0)[i] != i)
+                    layers[axis] = move_layers[k];
+            }
+            assert(layers[axis] >= 0);
+        }
+
+        int &piece = position_pieces[(layers[0] * dim + layers[1]) * dim + layers[2]];
+        if (piece < 0) {
+            int outer_num = 0;
+            for (int axis = 0; axis < 3; axis ++)
+                outer_num += (layers[axis] == 0 || layers[axis] == dim - 1);
+
+            piece = layout.piece_num ++;
+            layout.piece_facelets[piece] = i;
+            layout.piece_types[piece] = (outer_num == 3)? CORNER_PIECE: ((outer_num == 2)? EDGE_PIECE: CENTER_PIECE);
+        }
+        layout.facelet_pieces[i] = piece;
+    }
+    assert(layout.piece_num == dim * dim * dim - (dim - 2) * (dim - 2) * (dim - 2));
+}
+
+
+RubikCubePermutation::RubikCubePermutation(const int& dim/* = 3*/):
+    dim_(dim), facelet_num_(face_num * dim * dim) {
+    assert(dim >= min_dim && dim <= max_dim);
+    for (int i = 0; i < facelet_num_; i ++)
+        perm_[i] = i;
+    for (int f = 0; f < face_num; f ++)
+        face_perm_[f] = f;
+}
+
+
+RubikCubePermutation::RubikCubePermutation(const std::string& moves, const int& dim/* = 3*/):
+    dim_(dim), facelet_num_(face_num * dim * dim) {
+    assert(dim >= min_dim && dim <= max_dim);
+    for (int i = 0; i < facelet_num_; i ++)
+        perm_[i] = i;
+    for (int f = 0; f < face_num; f ++)
+        face_perm_[f] = f;
+    Move(moves);
+}
+
+
+RubikCubePermutation RubikCubePermutation::Compile(const std::string& moves, const int& dim/* = 3*/) {
+    assert(dim >= min_dim && dim <= max_dim);
+
+    thread_local std::unordered_map<std::string, RubikCubePermutation> caches[max_dim - min_dim + 1];
+    std::unordered_map<std::string, RubikCubePermutation> &cache = caches[dim - min_dim];
+
+    std::unordered_map<std::string, RubikCubePermutation>::const_iterator it = cache.find(moves);
+    if (it != cache.end())
+        return it->second;
+
+    if (cache.size() >= max_cached_num)
+        cache.clear();
+    return cache.insert(std::make_pair(moves, RubikCubePermutation(moves, dim))).first->second;
+}
+
+
+bool RubikCubePermutation::IsIdentity() const {
+    for (int i = 0; i < facelet_num_; i ++)
+        if (perm_[i] != i)
+            return false;
+    for (int f = 0; f < face_num; f ++)
+        if (face_perm_[f] != f)
+            return false;
+    return true;
+}
+
+
+bool RubikCubePermutation::operator==(const RubikCubePermutation& other) const {
+    return dim_ == other.dim_ && std::memcmp(perm_, other.perm_, facelet_num_) == 0 &&
+           std::memcmp(face_perm_, other.face_perm_, face_num) == 0;
+}
+
+
+void RubikCubePermutation::Move(const std::string& moves) {
+    unsigned char new_perm[max_facelet_num];
+    unsigned char new_face_perm[UNKNOWN_FACE];
+
+    for (int i = 0; i < moves.length(); i ++) {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        const char *move_char = std::strchr(move_chars, moves[i]);
+        assert(move_char != NULL && *move_char != '\0');
+        assert(dim_ > 2 || move_char - move_chars < UNKNOWN_FACE || move_char - move_chars >= UNKNOWN_SLICE);
+
+        int turn = 0;
+        // peek next char
+        if ((i + 1) < moves.length()) {
+            if (moves[i + 1] == '\'' || moves[i + 1] == 'i')
+                turn = 2;
+            else if (moves[i + 1] == '2')
+                turn = 1;
+        }
+
+        const unsigned char *move_face_perm;
+        const unsigned char *move_perm = GetMovePermutation(dim_, move_char - move_chars, turn, &move_face_perm);
+        for (int j = 0; j < facelet_num_; j ++)
+            new_perm[j] = perm_[move_perm[j]];
+        std::memcpy(perm_, new_perm, facelet_num_);
+        for (int f = 0; f < face_num; f ++)
+            new_face_perm[f] = face_perm_[move_face_perm[f]];
+        std::memcpy(face_perm_, new_face_perm, face_num);
+    }
+}
+
+
+void RubikCubePermutation::Multiply(const RubikCubePermutation& other) {
+    assert(dim_ == other.dim_);
+
+    unsigned char new_perm[max_facelet_num];
+    for (int i = 0; i < facelet_num_; i ++)
+        new_perm[i] = perm_[other.perm_[i]];
+    std::memcpy(perm_, new_perm, facelet_num_);
+
+    unsigned char new_face_perm[UNKNOWN_FACE];
+    for (int f = 0; f < face_num; f ++)
+        new_face_perm[f] = face_perm_[other.face_perm_[f]];
+    std::memcpy(face_perm_, new_face_perm, face_num);
+}
+
+
+void RubikCubePermutation::Apply(const char* src, char* dst) const {
+    for (int i = 0; i < facelet_num_; i ++)
+        dst[i] = src[perm_[i]];
+}
+
+
+bool RubikCubePermutation::IsSolving(const char* colors) const {
+    char moved[max_facelet_num];
+    Apply(colors, moved);
+
+    // Compare whole faces without early exits, so the loop vectorizes
+    const int piece_num = dim_ * dim_;
+    unsigned char diff = 0;
+    for (int f = 0; f < face_num; f ++) {
+        const char *face = &moved[f * piece_num];
+        for (int i = 1; i < piece_num; i ++)
+            diff |= face[i] ^ face[0];
+    }
+    return diff == 0;
+}
+
+
+RubikCubePermutation RubikCubePermutation::GetInverse() const {
+    RubikCubePermutation inverse(dim_);
+    for (int i = 0; i < facelet_num_; i ++)
+        inverse.perm_[perm_[i]] = i;
+    for (int f = 0; f < face_num; f ++)
+        inverse.face_perm_[face_perm_[f]] = f;
+    return inverse;
+}
+
+
+unsigned long long RubikCubePermutation::GetOrder() const {
+    bool visited[max_facelet_num] = {false};
+    bool face_visited[UNKNOWN_FACE] = {false};
+    unsigned long long order = 1;
+
+    // Cycles of the facelets, then of the faces for whole cube rotations
+    for (int i = 0; i < facelet_num_ + face_num; i ++) {
+        const bool is_face = (i >= facelet_num_);
+        const unsigned char *perm = is_face? face_perm_: perm_;
+        bool *cycle_visited = is_face? face_visited: visited;
+        const int start = is_face? (i - facelet_num_): i;
+        if (cycle_visited[start])
+            continue;
+
+        unsigned long long length = 0;
+        int j = start;
+        do {
+            cycle_visited[j] = true;
+            j = perm[j];
+            length ++;
+        } while (j != start);
+
+        // order = lcm(order, length)
+        unsigned long long a = order, b = length;
+        while (b) {
+            unsigned long long t = a % b;
+            a = b;
+            b = t;
+        }
+        order = order / a * length;
+    }
+    return order;
+}
+
+
+void RubikCubePermutation::GetPieceCycles(const PIECE_TYPE& type, std::vector<PieceCycle>& cycles) const {
+    const PieceLayout &layout = GetPieceLayout(dim_);
+    bool visited[max_piece_num] = {false};
+
+    cycles.clear();
+    for (int p = 0; p < layout.piece_num; p ++) {
+        if (visited[p] || layout.piece_types[p] != type)
+            continue;
+
+        // Position q gets the piece which was at the source of its first facelet
+        int length = 0;
+        int q = p;
+        do {
+            visited[q] = true;
+            q = layout.facelet_pieces[perm_[layout.piece_facelets[q]]];
+            length ++;
+        } while (q != p);
+
+        // The facelet cycle is longer than the piece cycle if the pieces turn
+        const int first_facelet = layout.piece_facelets[p];
+        int facelet_length = 0;
+        int j = first_facelet;
+        do {
+            j = perm_[j];
+            facelet_length ++;
+        } while (j != first_facelet);
+
+        PieceCycle cycle = {length, facelet_length > length};
+        if (cycle.length > 1 || cycle.is_twisted)
+            cycles.push_back(cycle);
+    }
+}
+
+
+std::string RubikCubePermutation::GetCycleString() const {
+    std::string cycle_str;
+    std::vector<PieceCycle> cycles;
+
+    for (int t = 0; t < UNKNOWN_PIECE; t ++) {
+        GetPieceCycles((PIECE_TYPE)t, cycles);
+        if (t > 0)
+            cycle_str += ", ";
+        cycle_str += piece_type_names[t];
+        cycle_str += ':';
+        if (cycles.empty())
+            cycle_str += " -";
+        for (int i = 0; i < cycles.size(); i ++) {
+            cycle_str += " (" + std::to_string(cycles[i].length) + ')';
+            if (cycles[i].is_twisted)
+                cycle_str += '+';
+        }
+    }
+    return cycle_str;
+}
+
+
+std::string RubikCubePermutation::InvertMoves(const std::string& moves) {
+    std::string inverse_moves;
+
+    for (int i = (moves.length() - 1); i >= 0 ; i --) {
+        if (moves[i] == ' ' || moves[i] == '\'' || moves[i] == 'i' || moves[i] == '2')
+            continue;
+
+        if (inverse_moves.length())
+            inverse_moves += ' ';
+        inverse_moves += moves[i];
+        // peek next char
+        if ((i + 1) < moves.length() && moves[i + 1] == '2')
+            inverse_moves += '2';
+        else if ((i + 1) >= moves.length() || (moves[i + 1] != '\'' && moves[i + 1] != 'i'))
+            inverse_moves += '\'';
+    }
+    return inverse_moves;
+}
+
+
+// Pieces are keyed by their colors in sorted order, and every facelet of a piece of to
+// is taken from the facelet of the same color of the piece of from with the same key
+bool RubikCubePermutation::GetTransition(const char* from, const char* to, const int& dim, RubikCubePermutation& perm) {
+    assert(dim >= min_dim && dim <= max_dim);
+    const PieceLayout& layout = GetPieceLayout(dim);
+    const int facelet_num = face_num * dim * dim;
+
+    int piece_facelets[max_piece_num][3];
+    int piece_facelet_nums[max_piece_num] = {0};
+    for (int i = 0; i < facelet_num; i ++) {
+        const int piece = layout.facelet_pieces[i];
+        piece_facelets[piece][piece_facelet_nums[piece] ++] = i;
+    }
+
+    auto get_piece_key = [&](const char* colors, const int& piece) {
+        unsigned char piece_colors[3] = {0, 0, 0};
+        for (int k = 0; k < piece_facelet_nums[piece]; k ++)
+            piece_colors[k] = colors[piece_facelets[piece][k]];
+        std::sort(piece_colors, piece_colors + piece_facelet_nums[piece]);
+        return (piece_colors[0] << 16) | (piece_colors[1] << 8) | piece_colors[2];
+    };
+
+    int from_keys[max_piece_num];
+    for (int piece = 0; piece < layout.piece_num; piece ++) {
+        from_keys[piece] = get_piece_key(from, piece);
+        for (int other = 0; other < piece; other ++)
+            if (from_keys[other] == from_keys[piece])
+                return false;
+    }
+
+    perm = RubikCubePermutation(dim);
+    bool is_used[max_piece_num] = {false};
+    for (int piece = 0; piece < layout.piece_num; piece ++) {
+        const int key = get_piece_key(to, piece);
+        int from_piece = 0;
+        while (from_piece < layout.piece_num && from_keys[from_piece] != key)
+            from_piece ++;
+        if (from_piece == layout.piece_num || is_used[from_piece] ||
+            piece_facelet_nums[from_piece] != piece_facelet_nums[piece])
+            return false;
+        is_used[from_piece] = true;
+
+        for (int k = 0; k < piece_facelet_nums[piece]; k ++) {
+            const int facelet = piece_facelets[piece][k];
+            int l = 0;
+            while (from[piece_facelets[from_piece][l]] != to[facelet])
+                l ++;
+            perm.perm_[facelet] = piece_facelets[from_piece][l];
+        }
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "rubik_cube.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace rb {
+
+enum PIECE_TYPE {
+    CORNER_PIECE = 0,
+    EDGE_PIECE,
+    CENTER_PIECE,
+    UNKNOWN_PIECE
+};
+
+// A cycle of length pieces. If is_twisted, going around the cycle once also
+// twists or flips the pieces, so they are only back after more rounds.
+// A single piece turned in place is a cycle of length 1.
+struct PieceCycle {
+    int length;
+    bool is_twisted;
+};
+
+// Facelet permutation of a move sequence, using the move semantics of RubikCube::Move,
+// for dims 2 to 5.
+// Facelets are indexed in RubikCube face order (U, L, F, R, B, D), row by row, and
+// after the moves facelet i holds what was at facelet perm[i] before.
+// Whole cube rotations x, y and z also move the faces themselves, which RubikCube
+// keeps in its face mappings, so the face permutation is carried along the same way.
+class RubikCubePermutation {
+  public:
+    explicit RubikCubePermutation(const int& dim = 3);
+    RubikCubePermutation(const std::string& moves, const int& dim = 3);
+
+    // Compile moves through a per-thread cache keyed by the move string,
+    // for algorithms which are applied over and over
+    static RubikCubePermutation Compile(const std::string& moves, const int& dim = 3);
+
+    int GetDim() const { return dim_; }
+    int GetFaceletNum() const { return facelet_num_; }
+    int operator[](const int& idx) const { return perm_[idx]; }
+    // After the moves face i is the face which was face GetFaceSource(i) before
+    int GetFaceSource(const int& face) const { return face_perm_[face]; }
+
+    bool IsIdentity() const;
+    bool operator==(const RubikCubePermutation& other) const;
+    bool operator!=(const RubikCubePermutation& other) const { return !(*this == other); }
+    // Append moves, or another permutation, after this one
+    void Move(const std::string& moves);
+    void Multiply(const RubikCubePermutation& other);
+
+    // dst[i] = src[perm[i]], src and dst may not overlap
+    void Apply(const char* src, char* dst) const;
+    // Whether every face has a single color after applying the permutation to colors
+    bool IsSolving(const char* colors) const;
+
+    // The permutation which undoes this one
+    RubikCubePermutation GetInverse() const;
+    // Smallest number of repetitions which gives the identity
+    unsigned long long GetOrder() const;
+    // Non-trivial cycles of the pieces of one type
+    void GetPieceCycles(const PIECE_TYPE& type, std::vector<PieceCycle>& cycles) const;
+    // Cycles of all piece types, e.g. "corners: (3) (2)+, edges: (4), centers: -",
+    // where + marks cycles which twist or flip their pieces
+    std::string GetCycleString() const;
+
+    // Reverse a move sequence, e.g. "R U2 F'" gives "F U2 R'"
+    static std::string InvertMoves(const std::string& moves);
+    // The permutation which takes the facelet colors from to the colors to, found by the
+    // colors of every piece, so only for cubes whose pieces all differ in colors, the
+    // 2x2x2 and 3x3x3. False when the two don't have the same pieces.
+    static bool GetTransition(const char* from, const char* to, const int& dim, RubikCubePermutation& perm);
+
+  private:
+    static const int max_facelet_num = 6 * 5 * 5;
+    static const int max_piece_num = 5 * 5 * 5 - 3 * 3 * 3;
+
+    struct PieceLayout {
+        int piece_num;
+        unsigned char facelet_pieces[max_facelet_num];  // piece of every facelet
+        unsigned char piece_facelets[max_piece_num];    // first facelet of every piece
+        unsigned char piece_types[max_piece_num];
+    };
+
+    static const PieceLayout& GetPieceLayout(const int& dim);
+    static void BuildPieceLayout(const int& dim, PieceLayout& layout);
+
+    static const unsigned char* GetMovePermutation(const int& dim, const int& move_char_idx, const int& turn,
+                                                   const unsigned char** face_perm = NULL);
+    static void BuildMovePermutation(const int& dim, const int& move_char_idx, unsigned char (*turn_perms)[max_facelet_num],
+                                     unsigned char (*turn_face_perms)[UNKNOWN_FACE]);
+
+    int dim_;
+    int facelet_num_;
+    unsigned char perm_[max_facelet_num];
+    unsigned char face_perm_[UNKNOWN_FACE];
+};
+
+}
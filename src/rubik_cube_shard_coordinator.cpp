@@ -0,0 +1,623 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_shard_coordinator.hpp"
+#include "rubik_cube.hpp"
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_validator.hpp"
+
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cassert>
+#include <csignal>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace rb;
+
+static const char* checkpoint_name = "checkpoint.txt";
+static const int copy_buf_len = 1 << 20;
+static const int max_message_len = 4096;
+// Poll wakes up this often to notice local workers which died without a word
+static const int reap_interval_ms = 1000;
+
+
+static bool SetNonBlocking(const int& fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+static bool SendLine(const int& fd, const std::string& line) {
+    const std::string message = line + "\n";
+    size_t pos = 0;
+    while (pos < message.length()) {
+        ssize_t len = send(fd, message.data() + pos, message.length() - pos, MSG_NOSIGNAL);
+        if (len > 0)
+            pos += len;
+        else if (len < 0 && errno == EINTR)
+            continue;
+        else
+            return false;
+    }
+    return true;
+}
+
+
+static bool IsFile(const std::string& path) {
+    return access(path.c_str(), R_OK) == 0;
+}
+
+
+// Write a file under a temporary name, sync it and rename it into place, so a file
+// under path is always complete whenever the writer dies
+static bool CommitFile(FILE* fp, const std::string& tmp_path, const std::string& path) {
+    bool is_ok = (std::fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+    is_ok &= (std::fclose(fp) == 0);
+    return is_ok && std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+
+RubikCubeShardCoordinator::RubikCubeShardCoordinator(const ShardJob& job):
+    job_(job), listen_fd_(-1), is_stopped_(false), input_size_(0), done_num_(0), checkpoint_fd_(-1) {
+    assert(job.shard_lines > 0);
+
+    int ret = pipe(wake_fds_);
+    assert(ret == 0);
+    SetNonBlocking(wake_fds_[0]);
+    SetNonBlocking(wake_fds_[1]);
+    shard_offsets_.push_back(0);
+}
+
+
+RubikCubeShardCoordinator::~RubikCubeShardCoordinator() {
+    for (std::map<int, Worker>::iterator it = workers_.begin(); it != workers_.end(); ++ it)
+        close(it->first);
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        if (address_.compare(0, 5, "unix:") == 0)
+            unlink(address_.c_str() + 5);
+    }
+    if (checkpoint_fd_ >= 0)
+        close(checkpoint_fd_);
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+}
+
+
+bool RubikCubeShardCoordinator::Listen(const std::string& address) {
+    assert(listen_fd_ < 0);
+
+    int fd;
+    if (address.compare(0, 5, "unix:") == 0) {
+        const std::string path = address.substr(5);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.length() >= sizeof(addr.sun_path))
+            return false;
+        std::strcpy(addr.sun_path, path.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        unlink(path.c_str());
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return false;
+        }
+        address_ = address;
+    } else {
+        // Workers on other machines connect too, so any interface is listened on
+        const int port = std::atoi(address.c_str());
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (port <= 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return false;
+        }
+        address_ = "127.0.0.1:" + std::to_string(port);
+    }
+
+    if (listen(fd, SOMAXCONN) != 0 || !SetNonBlocking(fd)) {
+        close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    return true;
+}
+
+
+void RubikCubeShardCoordinator::Stop() {
+    is_stopped_ = true;
+    char wake_char = 's';
+    ssize_t ret = write(wake_fds_[1], &wake_char, 1);
+    (void)ret;
+}
+
+
+// Byte offsets of every shard_lines lines, found in one pass over the input
+bool RubikCubeShardCoordinator::SplitInput() {
+    FILE *fp = std::fopen(job_.input_path.c_str(), "rb");
+    if (!fp) {
+        std::cerr << "Can't read " << job_.input_path << std::endl;
+        return false;
+    }
+
+    std::vector<char> buf(copy_buf_len);
+    uint64_t offset = 0;
+    int line_num = 0;
+    size_t len;
+    while ((len = std::fread(&buf[0], 1, buf.size(), fp)) > 0) {
+        for (size_t i = 0; i < len; i ++) {
+            if (buf[i] != '\n' || ++ line_num < job_.shard_lines)
+                continue;
+            shard_offsets_.push_back(offset + i + 1);
+            line_num = 0;
+        }
+        offset += len;
+    }
+    std::fclose(fp);
+
+    input_size_ = offset;
+    if (shard_offsets_.back() != input_size_)
+        shard_offsets_.push_back(input_size_);
+    shard_states_.assign(GetShardNum(), SHARD_PENDING);
+    return true;
+}
+
+
+// The checkpoint starts with the job it belongs to, then has a "done <shard>" line
+// per finished shard. A resumed job must split the same input the same way.
+bool RubikCubeShardCoordinator::LoadCheckpoint() {
+    const std::string path = job_.work_dir + "/" + checkpoint_name;
+    std::ostringstream header;
+    header << "job " << input_size_ << " " << job_.shard_lines << " " << GetShardNum() << " " << job_.solver;
+
+    FILE *fp = std::fopen(path.c_str(), "r");
+    if (fp) {
+        char line[256];
+        std::string saved_header = std::fgets(line, sizeof(line), fp)? line: "";
+        saved_header.erase(saved_header.find_last_not_of("\r\n") + 1);
+        if (saved_header != header.str()) {
+            std::cerr << "Checkpoint " << path << " is of another job: " << saved_header << std::endl;
+            std::fclose(fp);
+            return false;
+        }
+
+        // A shard whose file is gone, e.g. removed after a merge which didn't finish, is solved again
+        int shard;
+        while (std::fscanf(fp, " done %d", &shard) == 1) {
+            if (shard >= 0 && shard < GetShardNum() && shard_states_[shard] != SHARD_DONE && IsFile(GetShardPath(shard))) {
+                shard_states_[shard] = SHARD_DONE;
+                done_num_ ++;
+            }
+        }
+        std::fclose(fp);
+        checkpoint_fd_ = open(path.c_str(), O_WRONLY | O_APPEND);
+        return checkpoint_fd_ >= 0;
+    }
+
+    checkpoint_fd_ = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC, 0644);
+    return checkpoint_fd_ >= 0 && AppendCheckpoint(header.str());
+}
+
+
+bool RubikCubeShardCoordinator::AppendCheckpoint(const std::string& line) {
+    const std::string record = line + "\n";
+    return write(checkpoint_fd_, record.data(), record.length()) == (ssize_t)record.length() &&
+           fdatasync(checkpoint_fd_) == 0;
+}
+
+
+std::string RubikCubeShardCoordinator::GetShardPath(const int& shard) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/shard-%06d.txt", shard);
+    return job_.work_dir + name;
+}
+
+
+bool RubikCubeShardCoordinator::Run(const int& local_worker_num) {
+    assert(listen_fd_ >= 0);
+    if (!SplitInput() || !LoadCheckpoint())
+        return false;
+
+    for (int i = 0; i < local_worker_num && done_num_ < GetShardNum(); i ++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // The worker only needs its own connection
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            close(listen_fd_);
+            close(checkpoint_fd_);
+            _exit((RunShardWorker(address_) >= 0)? 0: 1);
+        }
+        if (pid > 0)
+            local_pids_.push_back(pid);
+    }
+
+    std::vector<pollfd> poll_fds;
+    while (!is_stopped_ && done_num_ < GetShardNum()) {
+        poll_fds.clear();
+        pollfd wake_pfd = {wake_fds_[0], POLLIN, 0};
+        poll_fds.push_back(wake_pfd);
+        pollfd listen_pfd = {listen_fd_, POLLIN, 0};
+        poll_fds.push_back(listen_pfd);
+        for (std::map<int, Worker>::iterator it = workers_.begin(); it != workers_.end(); ++ it) {
+            pollfd worker_pfd = {it->first, POLLIN, 0};
+            poll_fds.push_back(worker_pfd);
+        }
+
+        if (poll(&poll_fds[0], poll_fds.size(), reap_interval_ms) < 0 && errno != EINTR)
+            break;
+
+        if (poll_fds[0].revents & POLLIN) {
+            char drain_buf[256];
+            while (read(wake_fds_[0], drain_buf, sizeof(drain_buf)) > 0)
+                ;
+        }
+        if (poll_fds[1].revents & POLLIN)
+            AcceptWorkers();
+        for (int i = 2; i < poll_fds.size(); i ++) {
+            std::map<int, Worker>::iterator it = workers_.find(poll_fds[i].fd);
+            if (poll_fds[i].revents && it != workers_.end() && !ReadWorker(it->second))
+                CloseWorker(poll_fds[i].fd);
+        }
+
+        // A dead local worker's shard went back to pending when its connection closed.
+        // Workers aren't started again, as one which crashed on a cube would crash again.
+        for (int i = 0; i < local_pids_.size(); i ++) {
+            if (waitpid(local_pids_[i], NULL, WNOHANG) == local_pids_[i])
+                local_pids_.erase(local_pids_.begin() + i --);
+        }
+        if (local_worker_num > 0 && local_pids_.empty() && workers_.empty() && done_num_ < GetShardNum()) {
+            std::cerr << "All local workers have exited, " << done_num_ << " of " << GetShardNum()
+                      << " shards done" << std::endl;
+            break;
+        }
+    }
+
+    const bool is_done = (done_num_ == GetShardNum());
+    for (std::map<int, Worker>::iterator it = workers_.begin(); it != workers_.end(); ++ it) {
+        if (is_done)
+            SendLine(it->first, "exit");
+        close(it->first);
+    }
+    workers_.clear();
+    for (int i = 0; i < local_pids_.size(); i ++) {
+        if (!is_done)
+            kill(local_pids_[i], SIGTERM);
+        waitpid(local_pids_[i], NULL, 0);
+    }
+    local_pids_.clear();
+
+    return is_done && MergeShards();
+}
+
+
+void RubikCubeShardCoordinator::AcceptWorkers() {
+    while (true) {
+        int fd = accept(listen_fd_, NULL, NULL);
+        if (fd < 0)
+            break;
+        if (!SetNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+
+        Worker &worker = workers_[fd];
+        worker.fd = fd;
+        worker.shard = -1;
+        worker.is_waiting = false;
+    }
+}
+
+
+// Handle every complete message. Returns false if the worker should be dropped.
+bool RubikCubeShardCoordinator::ReadWorker(Worker& worker) {
+    char read_buf[max_message_len];
+    while (true) {
+        ssize_t len = read(worker.fd, read_buf, sizeof(read_buf));
+        if (len > 0) {
+            worker.in_buf.append(read_buf, len);
+            continue;
+        }
+        if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+            return false;
+        break;
+    }
+
+    size_t pos = 0, end;
+    while ((end = worker.in_buf.find('\n', pos)) != std::string::npos) {
+        if (!HandleMessage(worker, worker.in_buf.substr(pos, end - pos)))
+            return false;
+        pos = end + 1;
+    }
+    worker.in_buf.erase(0, pos);
+    return worker.in_buf.length() < max_message_len;
+}
+
+
+bool RubikCubeShardCoordinator::HandleMessage(Worker& worker, const std::string& message) {
+    if (message == "next") {
+        if (worker.shard >= 0)
+            return false;
+        worker.is_waiting = true;
+        return AssignShard(worker);
+    }
+
+    int shard;
+    if (std::sscanf(message.c_str(), "done %d", &shard) != 1 || shard != worker.shard ||
+        !IsFile(GetShardPath(shard)))
+        return false;
+
+    // Recorded before anything else happens, a crash right after loses nothing
+    if (!AppendCheckpoint("done " + std::to_string(shard))) {
+        std::cerr << "Can't write the checkpoint: " << std::strerror(errno) << std::endl;
+        Stop();
+        return false;
+    }
+    shard_states_[shard] = SHARD_DONE;
+    done_num_ ++;
+    worker.shard = -1;
+    return true;
+}
+
+
+bool RubikCubeShardCoordinator::AssignShard(Worker& worker) {
+    const std::vector<char>::iterator it = std::find(shard_states_.begin(), shard_states_.end(), (char)SHARD_PENDING);
+    if (it == shard_states_.end())
+        return true;
+
+    const int shard = it - shard_states_.begin();
+    std::ostringstream message;
+    message << "shard " << shard << "\t" << job_.solver << "\t" << shard_offsets_[shard] << "\t"
+            << shard_offsets_[shard + 1] << "\t" << job_.input_path << "\t" << GetShardPath(shard);
+    if (!SendLine(worker.fd, message.str()))
+        return false;
+
+    *it = SHARD_RUNNING;
+    worker.shard = shard;
+    worker.is_waiting = false;
+    return true;
+}
+
+
+void RubikCubeShardCoordinator::CloseWorker(const int& fd) {
+    std::map<int, Worker>::iterator it = workers_.find(fd);
+    if (it == workers_.end())
+        return;
+    const int shard = it->second.shard;
+    close(fd);
+    workers_.erase(it);
+    if (shard < 0)
+        return;
+
+    // The shard goes to a worker waiting for one, or to the next asking. Waiting workers
+    // which can't be sent it are dropped, and it's offered to the next of them.
+    shard_states_[shard] = SHARD_PENDING;
+    std::vector<int> failed_fds;
+    for (it = workers_.begin(); it != workers_.end(); ++ it) {
+        if (!it->second.is_waiting)
+            continue;
+        if (AssignShard(it->second))
+            break;
+        failed_fds.push_back(it->first);
+    }
+    // Waiting workers have no shard, closing them frees none
+    for (int i = 0; i < failed_fds.size(); i ++)
+        CloseWorker(failed_fds[i]);
+}
+
+
+bool RubikCubeShardCoordinator::MergeShards() {
+    const std::string tmp_path = job_.output_path + ".tmp";
+    FILE *out = std::fopen(tmp_path.c_str(), "wb");
+    if (!out)
+        return false;
+
+    std::vector<char> buf(copy_buf_len);
+    for (int i = 0; i < GetShardNum(); i ++) {
+        FILE *in = std::fopen(GetShardPath(i).c_str(), "rb");
+        if (!in) {
+            std::fclose(out);
+            return false;
+        }
+        size_t len;
+        while ((len = std::fread(&buf[0], 1, buf.size(), in)) > 0)
+            std::fwrite(&buf[0], 1, len, out);
+        std::fclose(in);
+    }
+    if (!CommitFile(out, tmp_path, job_.output_path))
+        return false;
+
+    // The checkpoint goes last, so a crash while cleaning up still finds the job done
+    // up to the shards already removed
+    for (int i = 0; i < GetShardNum(); i ++)
+        unlink(GetShardPath(i).c_str());
+    // and the temporary files of workers killed while solving
+    DIR *dir = opendir(job_.work_dir.c_str());
+    for (dirent *entry = dir? readdir(dir): NULL; entry; entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.compare(0, 6, "shard-") == 0 && name.length() > 4 && name.compare(name.length() - 4, 4, ".tmp") == 0)
+            unlink((job_.work_dir + "/" + name).c_str());
+    }
+    if (dir)
+        closedir(dir);
+    close(checkpoint_fd_);
+    checkpoint_fd_ = -1;
+    unlink((job_.work_dir + "/" + checkpoint_name).c_str());
+    return true;
+}
+
+
+static int ConnectCoordinator(const std::string& address) {
+    if (address.compare(0, 5, "unix:") == 0) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (address.length() - 5 >= sizeof(addr.sun_path))
+            return -1;
+        std::strcpy(addr.sun_path, address.c_str() + 5);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos)
+        return -1;
+    addrinfo hints, *infos;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(address.substr(0, colon).c_str(), address.c_str() + colon + 1, &hints, &infos) != 0)
+        return -1;
+    int fd = -1;
+    for (addrinfo *info = infos; info && fd < 0; info = info->ai_next) {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(infos);
+    return fd;
+}
+
+
+// Blocking read of the next line from the coordinator
+static bool ReceiveLine(const int& fd, std::string& buf, std::string& line) {
+    size_t end;
+    while ((end = buf.find('\n')) == std::string::npos) {
+        char read_buf[max_message_len];
+        ssize_t len = read(fd, read_buf, sizeof(read_buf));
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len <= 0)
+            return false;
+        buf.append(read_buf, len);
+    }
+    line = buf.substr(0, end);
+    buf.erase(0, end + 1);
+    return true;
+}
+
+
+// Solve the lines from begin to end of the input into the shard file
+static bool SolveShard(RubikCubeSolver& solver, const int& dim, const std::string& input_path,
+                       const uint64_t& begin, const uint64_t& end, const std::string& shard_path) {
+    FILE *in = std::fopen(input_path.c_str(), "rb");
+    if (!in)
+        return false;
+    std::string lines(end - begin, '\0');
+    const bool is_read = (fseeko(in, begin, SEEK_SET) == 0 &&
+                          std::fread(&lines[0], 1, lines.length(), in) == lines.length());
+    std::fclose(in);
+    if (!is_read)
+        return false;
+
+    // A worker of a coordinator which died may still be solving the same shard, so every
+    // worker writes its own temporary file
+    char host_name[256] = {0};
+    gethostname(host_name, sizeof(host_name) - 1);
+    const std::string tmp_path = shard_path + "." + host_name + "." + std::to_string(getpid()) + ".tmp";
+    FILE *out = std::fopen(tmp_path.c_str(), "wb");
+    if (!out)
+        return false;
+    size_t pos = 0;
+    while (pos < lines.length()) {
+        size_t line_end = lines.find('\n', pos);
+        if (line_end == std::string::npos)
+            line_end = lines.length();
+        std::string colors = lines.substr(pos, line_end - pos);
+        if (!colors.empty() && colors[colors.length() - 1] == '\r')
+            colors.erase(colors.length() - 1);
+        pos = line_end + 1;
+
+        // Bad cubes must never reach a solver, they could make it hang
+        const std::string moves = (ValidateCube(colors, dim) == CUBE_STATE_VALID)?
+                                  solver.Solve(RubikCube(colors.c_str(), dim)): "-";
+        std::fputs(moves.c_str(), out);
+        std::fputc('\n', out);
+    }
+    return CommitFile(out, tmp_path, shard_path);
+}
+
+
+int rb::RunShardWorker(const std::string& address) {
+    const int fd = ConnectCoordinator(address);
+    if (fd < 0)
+        return -1;
+
+    // Solvers are made on first use and reused for every shard
+    std::map<std::string, std::pair<std::unique_ptr<RubikCubeSolver>, int> > solvers;
+    std::string buf, line;
+    int solved_num = 0;
+    while (SendLine(fd, "next") && ReceiveLine(fd, buf, line) && line != "exit") {
+        std::vector<std::string> fields;
+        std::istringstream tokens(line);
+        std::string field;
+        while (std::getline(tokens, field, '\t'))
+            fields.push_back(field);
+        int shard;
+        if (fields.size() != 6 || std::sscanf(fields[0].c_str(), "shard %d", &shard) != 1)
+            break;
+
+        std::pair<std::unique_ptr<RubikCubeSolver>, int> &solver = solvers[fields[1]];
+        if (!solver.first)
+            solver.first.reset(CreateSolver(fields[1], solver.second));
+        if (!solver.first || !SolveShard(*solver.first, solver.second, fields[4],
+                                         std::strtoull(fields[2].c_str(), NULL, 10),
+                                         std::strtoull(fields[3].c_str(), NULL, 10), fields[5])) {
+            std::cerr << "Can't solve shard " << shard << " into " << fields[5] << std::endl;
+            solved_num = -1;
+            break;
+        }
+        if (!SendLine(fd, "done " + std::to_string(shard)))
+            break;
+        solved_num ++;
+    }
+    close(fd);
+    return solved_num;
+}
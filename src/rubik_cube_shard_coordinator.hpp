@@ -0,0 +1,127 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+
+namespace rb {
+
+/*
+ * Sharded batch solving for corpora too big for one process or one run.
+ *
+ * The input has the colors of a cube per line, as RubikCube(colors, dim) takes them,
+ * and the output gets the solution of every line in the same order, "-" for cubes
+ * ValidateCube rejects. The input is split into shards of shard_lines lines, which
+ * worker processes take from the coordinator one at a time over a unix or TCP socket.
+ * A worker writes the solutions of a shard into its own file in the work directory and
+ * renames it into place before reporting it done, and the coordinator then appends the
+ * shard to the checkpoint file there and syncs it. A coordinator started again on the
+ * same job only hands out the shards the checkpoint doesn't have, and once all shards
+ * are done it concatenates their files into the output.
+ *
+ * Workers get the input and shard file paths from the coordinator, so workers on other
+ * machines need the work directory and the input at the same paths, e.g. on NFS.
+ *
+ * Protocol, a line per message:
+ * Worker:      "next" | "done <shard>"
+ * Coordinator: "shard <shard>\t<solver>\t<begin>\t<end>\t<input path>\t<shard path>" | "exit"
+ * where begin and end are byte offsets of the shard lines in the input. "next" is only
+ * answered when a shard is free, or with "exit" once there are no shards left.
+ */
+
+struct ShardJob {
+    ShardJob(): solver("thistlethwaite"), shard_lines(100000) {}
+
+    std::string input_path;
+    std::string output_path;
+    std::string work_dir;       // shard files and the checkpoint
+    std::string solver;         // basic, cfop, thistlethwaite, bidirectional or pocket
+    int shard_lines;
+};
+
+class RubikCubeShardCoordinator {
+  public:
+    explicit RubikCubeShardCoordinator(const ShardJob& job);
+    ~RubikCubeShardCoordinator();
+
+    // Address is "unix:PATH", or "PORT" to take workers from other machines over TCP
+    bool Listen(const std::string& address);
+
+    // Split the input, or resume the shards of the checkpoint, fork local_worker_num
+    // worker processes and serve shards until all are done, then merge the output.
+    // Returns false when stopped or failed before the output is merged, keeping the
+    // checkpoint and the shard files done so far.
+    bool Run(const int& local_worker_num);
+    // Safe to call from signal handlers
+    void Stop();
+
+    int GetShardNum() const { return shard_offsets_.size() - 1; }
+    int GetDoneShardNum() const { return done_num_; }
+
+  private:
+    RubikCubeShardCoordinator(const RubikCubeShardCoordinator& other);
+    RubikCubeShardCoordinator& operator=(const RubikCubeShardCoordinator& other);
+
+    enum SHARD_STATE {
+        SHARD_PENDING = 0,
+        SHARD_RUNNING,
+        SHARD_DONE
+    };
+
+    struct Worker {
+        int fd;
+        std::string in_buf;
+        int shard;              // the shard it's solving, -1 if none
+        bool is_waiting;        // asked for a shard while none was free
+    };
+
+    bool SplitInput();
+    bool LoadCheckpoint();
+    bool AppendCheckpoint(const std::string& line);
+    std::string GetShardPath(const int& shard) const;
+
+    void AcceptWorkers();
+    bool ReadWorker(Worker& worker);
+    bool HandleMessage(Worker& worker, const std::string& message);
+    bool AssignShard(Worker& worker);
+    void CloseWorker(const int& fd);
+    bool MergeShards();
+
+    ShardJob job_;
+    std::string address_;
+    int listen_fd_;
+    int wake_fds_[2];
+    volatile bool is_stopped_;
+
+    uint64_t input_size_;
+    std::vector<uint64_t> shard_offsets_;   // byte offset of every shard and the input end
+    std::vector<char> shard_states_;
+    int done_num_;
+    int checkpoint_fd_;
+    std::vector<int> local_pids_;
+    std::map<int, Worker> workers_;
+};
+
+// Connect to a coordinator at "unix:PATH" or "HOST:PORT" and solve the shards it
+// hands out until it has none left. Returns the number of shards solved, or -1 when
+// the coordinator can't be reached or a shard can't be read or written.
+int RunShardWorker(const std::string& address);
+
+}
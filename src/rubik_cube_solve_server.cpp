@@ -0,0 +1,491 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solve_server.hpp"
+#include "rubik_cube.hpp"
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_validator.hpp"
+#include "rubik_cube_table_memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace rb;
+
+static const int request_header_len = 10;     // request id, deadline, solver type, dim
+static const int max_frame_len = 1024;
+static const int max_in_buf_len = 1 << 16;    // unparsed requests buffered per connection
+static const int max_out_buf_len = 1 << 20;   // stop reading from clients which don't read responses
+static const int read_buf_len = 1 << 16;
+
+
+inline uint32_t ReadUint32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return ntohl(value);
+}
+
+
+inline void AppendUint32(std::string& buf, const uint32_t& value) {
+    uint32_t net_value = htonl(value);
+    buf.append((const char*)&net_value, sizeof(net_value));
+}
+
+
+static void AppendResponse(std::string& buf, const uint32_t& request_id,
+                           const SOLVE_STATUS& status, const std::string& moves) {
+    AppendUint32(buf, 4 + 1 + moves.length());
+    AppendUint32(buf, request_id);
+    buf += (char)status;
+    buf += moves;
+}
+
+
+static bool SetNonBlocking(const int& fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+
+// Only 3x3x3 solvers are available, and unsolvable cubes must never reach them.
+static bool IsValidRequest(const int& solver_type, const int& dim, const std::string& colors) {
+    if (solver_type < 0 || solver_type >= UNKNOWN_SOLVER || dim != 3)
+        return false;
+    return ValidateCube(colors, dim) == CUBE_STATE_VALID;
+}
+
+
+RubikCubeSolveServer::RubikCubeSolveServer(const int& worker_num/* = 4*/, const int& max_queued/* = 1024*/,
+                                           const int& max_batch/* = 32*/, const bool& is_numa_pinned/* = false*/):
+    listen_fd_(-1), is_stopped_(false), max_queued_(max_queued), max_batch_(max_batch),
+    is_numa_pinned_(is_numa_pinned), next_conn_id_(0), in_flight_(0) {
+    assert(worker_num > 0 && max_queued > 0 && max_batch > 0);
+
+    int ret = pipe(wake_fds_);
+    assert(ret == 0);
+    SetNonBlocking(wake_fds_[0]);
+    SetNonBlocking(wake_fds_[1]);
+
+    // Build the solver tables once, before any client is served
+    RubikCube cube(3);
+    cube.Move("R U F' L2 D B'");
+    RubikCube3CFOPSolver().Solve(cube);
+    RubikCube3ThistlethwaiteSolver().Solve(cube);
+
+    for (int i = 0; i < worker_num; i ++)
+        workers_.push_back(std::thread(&RubikCubeSolveServer::WorkerLoop, this, i));
+}
+
+
+RubikCubeSolveServer::~RubikCubeSolveServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopped_ = true;
+    }
+    queue_cond_.notify_all();
+    for (int i = 0; i < workers_.size(); i ++)
+        workers_[i].join();
+
+    for (std::map<int, Connection>::iterator it = conns_.begin(); it != conns_.end(); ++ it)
+        close(it->second.fd);
+    if (listen_fd_ >= 0)
+        close(listen_fd_);
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+}
+
+
+bool RubikCubeSolveServer::ListenUnix(const std::string& path) {
+    assert(listen_fd_ < 0);
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(addr.sun_path))
+        return false;
+    std::strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    unlink(path.c_str());
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 || !SetNonBlocking(fd)) {
+        close(fd);
+        return false;
+    }
+
+    listen_fd_ = fd;
+    return true;
+}
+
+
+bool RubikCubeSolveServer::ListenTcp(const int& port) {
+    assert(listen_fd_ < 0);
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 || !SetNonBlocking(fd)) {
+        close(fd);
+        return false;
+    }
+
+    listen_fd_ = fd;
+    return true;
+}
+
+
+void RubikCubeSolveServer::Stop() {
+    is_stopped_ = true;
+    char wake_char = 's';
+    ssize_t ret = write(wake_fds_[1], &wake_char, 1);
+    (void)ret;
+}
+
+
+void RubikCubeSolveServer::Run() {
+    std::vector<pollfd> poll_fds;
+    std::vector<int> poll_conn_ids;
+    std::vector<Request> batch;
+
+    while (!is_stopped_) {
+        // Backpressure: stop accepting and reading while the queue is full
+        int queue_room;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_room = max_queued_ - in_flight_;
+        }
+
+        poll_fds.clear();
+        poll_conn_ids.clear();
+
+        pollfd wake_pfd = {wake_fds_[0], POLLIN, 0};
+        poll_fds.push_back(wake_pfd);
+        pollfd listen_pfd = {listen_fd_, (short)((queue_room > 0)? POLLIN: 0), 0};
+        poll_fds.push_back(listen_pfd);
+
+        for (std::map<int, Connection>::iterator it = conns_.begin(); it != conns_.end(); ++ it) {
+            const Connection &conn = it->second;
+            short events = 0;
+            if (queue_room > 0 && !conn.is_closed && conn.in_buf.length() < max_in_buf_len &&
+                conn.out_buf.length() < max_out_buf_len)
+                events |= POLLIN;
+            if (!conn.out_buf.empty())
+                events |= POLLOUT;
+            // A connection with nothing to wait for is left out, or its hangup would wake
+            // every poll until the queue has room again
+            pollfd conn_pfd = {(events)? conn.fd: -1, events, 0};
+            poll_fds.push_back(conn_pfd);
+            poll_conn_ids.push_back(it->first);
+        }
+
+        if (poll(&poll_fds[0], poll_fds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (poll_fds[0].revents & POLLIN) {
+            char drain_buf[256];
+            while (read(wake_fds_[0], drain_buf, sizeof(drain_buf)) > 0)
+                ;
+        }
+        DeliverResponses();
+
+        if (poll_fds[1].revents & POLLIN)
+            AcceptConnections();
+
+        for (int i = 0; i < poll_conn_ids.size(); i ++) {
+            const short revents = poll_fds[i + 2].revents;
+            std::map<int, Connection>::iterator it = conns_.find(poll_conn_ids[i]);
+            if (!revents || it == conns_.end())
+                continue;
+
+            bool is_ok = !(revents & (POLLERR | POLLNVAL));
+            if (it->second.is_closed && (revents & POLLHUP))
+                is_ok = false;
+            if (is_ok && (revents & (POLLIN | POLLHUP)) && (poll_fds[i + 2].events & POLLIN))
+                is_ok = ReadConnection(it->second);
+            if (!is_ok)
+                CloseConnection(poll_conn_ids[i]);
+        }
+
+        // Collect the buffered requests of every connection into one batch,
+        // leaving the rest buffered while the queue is full
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_room = max_queued_ - in_flight_;
+        }
+        batch.clear();
+        std::vector<int> closing_ids;
+        for (std::map<int, Connection>::iterator it = conns_.begin(); it != conns_.end(); ++ it) {
+            Connection &conn = it->second;
+            bool is_ok = ParseRequests(it->first, conn, queue_room - (int)batch.size(), batch);
+            if (is_ok && !conn.out_buf.empty())
+                is_ok = WriteConnection(conn);
+            if (!is_ok || IsConnectionDone(conn))
+                closing_ids.push_back(it->first);
+        }
+        for (int i = 0; i < closing_ids.size(); i ++)
+            CloseConnection(closing_ids[i]);
+
+        if (!batch.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (int i = 0; i < batch.size(); i ++)
+                    queue_.push_back(batch[i]);
+                in_flight_ += batch.size();
+            }
+            queue_cond_.notify_all();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_stopped_ = true;
+    }
+    queue_cond_.notify_all();
+}
+
+
+void RubikCubeSolveServer::AcceptConnections() {
+    while (true) {
+        int fd = accept(listen_fd_, NULL, NULL);
+        if (fd < 0)
+            break;
+        if (!SetNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+
+        Connection &conn = conns_[next_conn_id_ ++];
+        conn.fd = fd;
+        conn.in_offset = 0;
+        conn.pending_num = 0;
+        conn.is_closed = false;
+    }
+}
+
+
+// Read available bytes up to the input buffer limit, noting when they arrived, which
+// deadlines count from. Returns false if the connection should be closed.
+bool RubikCubeSolveServer::ReadConnection(Connection& conn) {
+    char read_buf[read_buf_len];
+    const Clock::time_point now = Clock::now();
+    const size_t old_len = conn.in_buf.length();
+    while (conn.in_buf.length() < max_in_buf_len) {
+        ssize_t len = read(conn.fd, read_buf, sizeof(read_buf));
+        if (len > 0) {
+            conn.in_buf.append(read_buf, len);
+            continue;
+        }
+        if (len == 0)
+            conn.is_closed = true;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return false;
+        break;
+    }
+
+    if (conn.in_buf.length() > old_len) {
+        ReadChunk chunk = {conn.in_offset + conn.in_buf.length(), now};
+        conn.read_chunks.push_back(chunk);
+    }
+    return true;
+}
+
+
+// Parse at most max_num complete requests into the batch; invalid ones are answered directly.
+// Returns false on a malformed frame.
+bool RubikCubeSolveServer::ParseRequests(const int& conn_id, Connection& conn, const int& max_num,
+                                         std::vector<Request>& batch) {
+    int request_num = 0;
+    size_t pos = 0;
+    while (request_num < max_num && conn.in_buf.length() - pos >= 4) {
+        const uint32_t frame_len = ReadUint32(&conn.in_buf[pos]);
+        if (frame_len < request_header_len || frame_len > max_frame_len)
+            return false;
+        if (conn.in_buf.length() - pos < 4 + frame_len)
+            break;
+
+        // The request was received with the read which completed its frame
+        const uint64_t frame_end = conn.in_offset + pos + 4 + frame_len;
+        while (conn.read_chunks.front().end < frame_end)
+            conn.read_chunks.pop_front();
+
+        const char *frame = &conn.in_buf[pos + 4];
+        Request request;
+        request.conn_id = conn_id;
+        request.request_id = ReadUint32(frame);
+        const uint32_t deadline_ms = ReadUint32(frame + 4);
+        request.has_deadline = (deadline_ms > 0);
+        request.deadline = conn.read_chunks.front().time + std::chrono::milliseconds(deadline_ms);
+        request.solver_type = (unsigned char)frame[8];
+        request.dim = (unsigned char)frame[9];
+        request.colors.assign(frame + request_header_len, frame_len - request_header_len);
+        pos += 4 + frame_len;
+
+        if (IsValidRequest(request.solver_type, request.dim, request.colors)) {
+            batch.push_back(request);
+            request_num ++;
+        } else {
+            AppendResponse(conn.out_buf, request.request_id, SOLVE_BAD_REQUEST, "");
+        }
+    }
+    conn.in_buf.erase(0, pos);
+    conn.in_offset += pos;
+    conn.pending_num += request_num;
+    return true;
+}
+
+
+// A half-closed client still gets the responses of all its complete requests.
+bool RubikCubeSolveServer::IsConnectionDone(const Connection& conn) {
+    if (!conn.is_closed || conn.pending_num > 0 || !conn.out_buf.empty())
+        return false;
+    return conn.in_buf.length() < 4 || conn.in_buf.length() < 4 + ReadUint32(conn.in_buf.data());
+}
+
+
+// Write pending responses. Returns false if the connection should be closed.
+bool RubikCubeSolveServer::WriteConnection(Connection& conn) {
+    size_t pos = 0;
+    while (pos < conn.out_buf.length()) {
+        ssize_t len = send(conn.fd, conn.out_buf.data() + pos, conn.out_buf.length() - pos, MSG_NOSIGNAL);
+        if (len > 0) {
+            pos += len;
+            continue;
+        }
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            break;
+        return false;
+    }
+    conn.out_buf.erase(0, pos);
+    return true;
+}
+
+
+void RubikCubeSolveServer::DeliverResponses() {
+    std::vector<Response> responses;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        responses.swap(responses_);
+    }
+
+    for (int i = 0; i < responses.size(); i ++) {
+        std::map<int, Connection>::iterator it = conns_.find(responses[i].conn_id);
+        if (it != conns_.end()) {
+            it->second.out_buf += responses[i].frame;
+            it->second.pending_num --;
+        }
+    }
+
+    // Flush right away rather than waiting for the next poll
+    std::vector<int> closing_ids;
+    for (std::map<int, Connection>::iterator it = conns_.begin(); it != conns_.end(); ++ it) {
+        Connection &conn = it->second;
+        if (!conn.out_buf.empty() && !WriteConnection(conn))
+            closing_ids.push_back(it->first);
+    }
+    for (int i = 0; i < closing_ids.size(); i ++)
+        CloseConnection(closing_ids[i]);
+}
+
+
+void RubikCubeSolveServer::CloseConnection(const int& conn_id) {
+    std::map<int, Connection>::iterator it = conns_.find(conn_id);
+    if (it == conns_.end())
+        return;
+    close(it->second.fd);
+    conns_.erase(it);
+}
+
+
+void RubikCubeSolveServer::WorkerLoop(const int& worker_idx) {
+    // Pin before the solvers are made, so their memory is first touched on the node
+    if (is_numa_pinned_)
+        PinThreadToNumaNode(worker_idx % GetNumaNodeNum());
+
+    // Every worker keeps its own solvers, which are reused for all requests
+    RubikCube3BasicSolver basic_solver;
+    RubikCube3CFOPSolver cfop_solver;
+    RubikCube3ThistlethwaiteSolver thistlethwaite_solver;
+    RubikCubeSolver *solvers[UNKNOWN_SOLVER] = {&basic_solver, &cfop_solver, &thistlethwaite_solver};
+
+    std::vector<Request> batch;
+    std::vector<Response> responses;
+
+    while (true) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cond_.wait(lock, [this] { return is_stopped_ || !queue_.empty(); });
+            if (is_stopped_)
+                break;
+
+            // Take a micro-batch, but leave work for the other workers
+            int batch_len = std::min<int>(max_batch_, queue_.size() / workers_.size());
+            batch_len = std::max(batch_len, 1);
+            for (int i = 0; i < batch_len; i ++) {
+                batch.push_back(queue_.front());
+                queue_.pop_front();
+            }
+        }
+
+        responses.clear();
+        for (int i = 0; i < batch.size(); i ++) {
+            const Request &request = batch[i];
+            Response response;
+            response.conn_id = request.conn_id;
+
+            if (request.has_deadline && Clock::now() > request.deadline) {
+                AppendResponse(response.frame, request.request_id, SOLVE_DEADLINE_EXCEEDED, "");
+            } else {
+                RubikCube cube(request.colors.c_str(), request.dim);
+                std::string moves = solvers[request.solver_type]->Solve(cube);
+                AppendResponse(response.frame, request.request_id, SOLVE_OK, cube.CompressMoves(moves));
+            }
+            responses.push_back(response);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            responses_.insert(responses_.end(), responses.begin(), responses.end());
+            in_flight_ -= batch.size();
+        }
+        char wake_char = 'r';
+        ssize_t ret = write(wake_fds_[1], &wake_char, 1);
+        (void)ret;
+    }
+}
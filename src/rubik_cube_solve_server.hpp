@@ -0,0 +1,136 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+
+namespace rb {
+
+/*
+ * Solve service protocol, all integers are 32-bit big-endian.
+ *
+ * Request:  [frame length][request id][deadline ms][solver type: 1 byte][dim: 1 byte][colors]
+ * Response: [frame length][request id][status: 1 byte][moves]
+ *
+ * Frame length counts the bytes after the length field. Deadline 0 means no deadline,
+ * otherwise it's relative to the time the server receives the request.
+ */
+
+enum SOLVER_TYPE {
+    BASIC_SOLVER = 0,
+    CFOP_SOLVER,
+    THISTLETHWAITE_SOLVER,
+    UNKNOWN_SOLVER
+};
+
+enum SOLVE_STATUS {
+    SOLVE_OK = 0,
+    SOLVE_BAD_REQUEST,
+    SOLVE_DEADLINE_EXCEEDED,
+};
+
+
+class RubikCubeSolveServer {
+  public:
+    // With is_numa_pinned, worker i only runs on the CPUs of NUMA node i % node number,
+    // so its solvers and the tables it reads stay on its own node
+    RubikCubeSolveServer(const int& worker_num = 4, const int& max_queued = 1024, const int& max_batch = 32,
+                         const bool& is_numa_pinned = false);
+    ~RubikCubeSolveServer();
+
+    bool ListenUnix(const std::string& path);
+    bool ListenTcp(const int& port);
+
+    // Run the I/O loop until Stop() is called
+    void Run();
+    // Safe to call from other threads and signal handlers
+    void Stop();
+
+  private:
+    RubikCubeSolveServer(const RubikCubeSolveServer& other);
+    RubikCubeSolveServer& operator=(const RubikCubeSolveServer& other);
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Request {
+        int conn_id;
+        uint32_t request_id;
+        bool has_deadline;
+        Clock::time_point deadline;
+        int solver_type;
+        int dim;
+        std::string colors;
+    };
+
+    struct Response {
+        int conn_id;
+        std::string frame;
+    };
+
+    // Bytes of a connection received by one read, up to its stream offset end
+    struct ReadChunk {
+        uint64_t end;
+        Clock::time_point time;
+    };
+
+    struct Connection {
+        int fd;
+        std::string in_buf;
+        uint64_t in_offset;     // stream offset of in_buf[0]
+        std::deque<ReadChunk> read_chunks;
+        std::string out_buf;
+        int pending_num;        // requests queued or being solved
+        bool is_closed;         // peer has shut down its sending side
+    };
+
+    void AcceptConnections();
+    bool ReadConnection(Connection& conn);
+    bool ParseRequests(const int& conn_id, Connection& conn, const int& max_num, std::vector<Request>& batch);
+    bool WriteConnection(Connection& conn);
+    static bool IsConnectionDone(const Connection& conn);
+    void DeliverResponses();
+    void CloseConnection(const int& conn_id);
+
+    void WorkerLoop(const int& worker_idx);
+
+    int listen_fd_;
+    int wake_fds_[2];
+    volatile bool is_stopped_;
+
+    int max_queued_;
+    int max_batch_;
+    bool is_numa_pinned_;
+    int next_conn_id_;
+    int in_flight_;             // requests queued or being solved
+    std::map<int, Connection> conns_;
+
+    std::mutex mutex_;
+    std::condition_variable queue_cond_;
+    std::deque<Request> queue_;
+    std::vector<Response> responses_;
+    std::vector<std::thread> workers_;
+};
+
+}
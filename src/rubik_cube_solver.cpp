@@ -0,0 +1,428 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solver.hpp"
+#include "rubik_cube_3cubie.hpp"
+#include "rubik_cube_validator.hpp"
+
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+
+using namespace rb;
+
+static const unsigned char unknown_dist = 0xff;
+
+static const int co_coord_num = 2187;       // twists of the first 7 corners
+static const int eo_coord_num = 1 << 11;    // flips of the first 11 edges
+static const int slice_coord_num = 495;     // positions of the 4 E-slice edges
+static const int cp_coord_num = 40320;      // corner permutations
+
+static const int opposite_faces[UNKNOWN_FACE] = {D, R, B, L, F, U};
+static const char* turn_suffixes[3] = {"", "2", "'"};
+
+
+inline int GetCPCoord(const RubikCube3Cubie& cubie) {
+    int coord = 0;
+    for (int i = 0; i < CORNER_NUM; i ++) {
+        int smaller_num = 0;
+        for (int j = i + 1; j < CORNER_NUM; j ++)
+            smaller_num += (cubie.cp[j] < cubie.cp[i]);
+        coord = coord * (CORNER_NUM - i) + smaller_num;
+    }
+    return coord;
+}
+
+
+// Distances to solved of the pairs of coordinates (a, b), over all face turns
+static void BuildDistTable(const std::vector<unsigned short>& a_moves, const int& a_num,
+                           const std::vector<unsigned short>& b_moves, const int& b_num,
+                           std::vector<unsigned char>& dist) {
+    dist.assign(a_num * b_num, unknown_dist);
+    dist[0] = 0;
+    bool is_changed = true;
+    for (int depth = 0; is_changed; depth ++) {
+        is_changed = false;
+        for (int coord = 0; coord < a_num * b_num; coord ++) {
+            if (dist[coord] != depth)
+                continue;
+            const int a = coord / b_num, b = coord % b_num;
+            for (int m = 0; m < face_move_num; m ++) {
+                const int next = a_moves[a * face_move_num + m] * b_num + b_moves[b * face_move_num + m];
+                if (dist[next] == unknown_dist) {
+                    dist[next] = depth + 1;
+                    is_changed = true;
+                }
+            }
+        }
+    }
+}
+
+
+// Admissible distance estimates of a cube by its corner twists, edge flips,
+// E-slice edge positions and corner permutation, each never over the real distance
+struct EnumerationTables {
+    EnumerationTables(): co_moves(co_coord_num * face_move_num), eo_moves(eo_coord_num * face_move_num),
+                         cp_moves(cp_coord_num * face_move_num) {
+        std::vector<unsigned short> slice_moves(slice_coord_num * face_move_num);
+
+        for (int mask = 0, rank = 0; mask < (1 << EDGE_NUM); mask ++) {
+            slice_ranks[mask] = (__builtin_popcount(mask) == 4)? rank: -1;
+            if (slice_ranks[mask] >= 0)
+                slice_masks[rank ++] = mask;
+        }
+        solved_slice = slice_ranks[GetSliceMask(RubikCube3Cubie())];
+
+        for (int m = 0; m < face_move_num; m ++) {
+            for (int coord = 0; coord < co_coord_num; coord ++) {
+                RubikCube3Cubie cubie;
+                int twist_sum = 0;
+                for (int i = 0, c = coord; i < CORNER_NUM - 1; i ++, c /= 3) {
+                    cubie.co[i] = c % 3;
+                    twist_sum += cubie.co[i];
+                }
+                cubie.co[CORNER_NUM - 1] = (3 - twist_sum % 3) % 3;
+                cubie.Move(m);
+                co_moves[coord * face_move_num + m] = GetCOCoord(cubie);
+            }
+            for (int coord = 0; coord < eo_coord_num; coord ++) {
+                RubikCube3Cubie cubie;
+                int flip_sum = 0;
+                for (int i = 0; i < EDGE_NUM - 1; i ++) {
+                    cubie.eo[i] = (coord >> i) & 1;
+                    flip_sum += cubie.eo[i];
+                }
+                cubie.eo[EDGE_NUM - 1] = flip_sum & 1;
+                cubie.Move(m);
+                eo_moves[coord * face_move_num + m] = GetEOCoord(cubie);
+            }
+            for (int coord = 0; coord < slice_coord_num; coord ++) {
+                RubikCube3Cubie cubie;
+                for (int i = 0, slice_edge = FR, other_edge = UR; i < EDGE_NUM; i ++)
+                    cubie.ep[i] = (slice_masks[coord] & (1 << i))? slice_edge ++: other_edge ++;
+                cubie.Move(m);
+                slice_moves[coord * face_move_num + m] = slice_ranks[GetSliceMask(cubie)];
+            }
+            for (int coord = 0; coord < cp_coord_num; coord ++) {
+                RubikCube3Cubie cubie;
+                int used_mask = 0;
+                for (int i = 0, c = coord, radix = cp_coord_num; i < CORNER_NUM; i ++) {
+                    radix /= CORNER_NUM - i;
+                    int k = c / radix;
+                    c %= radix;
+                    int piece = 0;
+                    while ((used_mask & (1 << piece)) || k -- > 0)
+                        piece ++;
+                    used_mask |= 1 << piece;
+                    cubie.cp[i] = piece;
+                }
+                cubie.Move(m);
+                cp_moves[coord * face_move_num + m] = GetCPCoord(cubie);
+            }
+        }
+
+        // The solved slice coordinate isn't 0, so slice coordinates are stored relative to it
+        rel_slice_moves.resize(slice_moves.size());
+        for (int coord = 0; coord < slice_coord_num; coord ++)
+            for (int m = 0; m < face_move_num; m ++)
+                rel_slice_moves[coord * face_move_num + m] =
+                    (slice_moves[((coord + solved_slice) % slice_coord_num) * face_move_num + m] +
+                     slice_coord_num - solved_slice) % slice_coord_num;
+        std::vector<unsigned short> no_moves(face_move_num, 0);
+
+        BuildDistTable(co_moves, co_coord_num, rel_slice_moves, slice_coord_num, co_slice_dist);
+        BuildDistTable(eo_moves, eo_coord_num, rel_slice_moves, slice_coord_num, eo_slice_dist);
+        BuildDistTable(cp_moves, cp_coord_num, no_moves, 1, cp_dist);
+    }
+
+    void GetCoords(const RubikCube3Cubie& cubie, MinMoveCoords& coords) const {
+        coords.co = GetCOCoord(cubie);
+        coords.eo = GetEOCoord(cubie);
+        coords.slice = (slice_ranks[GetSliceMask(cubie)] + slice_coord_num - solved_slice) % slice_coord_num;
+        coords.cp = GetCPCoord(cubie);
+    }
+
+    int GetDist(const MinMoveCoords& coords) const {
+        return std::max(std::max(co_slice_dist[coords.co * slice_coord_num + coords.slice],
+                                 eo_slice_dist[coords.eo * slice_coord_num + coords.slice]),
+                        cp_dist[coords.cp]);
+    }
+
+    int GetDist(const RubikCube3Cubie& cubie) const {
+        MinMoveCoords coords;
+        GetCoords(cubie, coords);
+        return GetDist(coords);
+    }
+
+    short slice_ranks[1 << EDGE_NUM];
+    short slice_masks[slice_coord_num];
+    int solved_slice;
+    std::vector<unsigned short> co_moves;
+    std::vector<unsigned short> eo_moves;
+    std::vector<unsigned short> rel_slice_moves;
+    std::vector<unsigned short> cp_moves;
+    std::vector<unsigned char> co_slice_dist;
+    std::vector<unsigned char> eo_slice_dist;
+    std::vector<unsigned char> cp_dist;
+};
+
+
+static const EnumerationTables& GetEnumerationTables() {
+    static const EnumerationTables tables;
+    return tables;
+}
+
+
+void rb::GetMinMoveCoords(const RubikCube3Cubie& cubie, MinMoveCoords& coords) {
+    GetEnumerationTables().GetCoords(cubie, coords);
+}
+
+
+void rb::MoveMinMoveCoords(const MinMoveCoords& coords, const int& m, MinMoveCoords& next) {
+    const EnumerationTables &tables = GetEnumerationTables();
+    next.co = tables.co_moves[coords.co * face_move_num + m];
+    next.eo = tables.eo_moves[coords.eo * face_move_num + m];
+    next.slice = tables.rel_slice_moves[coords.slice * face_move_num + m];
+    next.cp = tables.cp_moves[coords.cp * face_move_num + m];
+}
+
+
+int rb::GetMinMoveNum(const MinMoveCoords& coords) {
+    return GetEnumerationTables().GetDist(coords);
+}
+
+
+// Depth-first search of the solutions of exactly depth moves, in canonical order:
+// no face turned twice in a row, and opposite faces turned in one order only.
+// Returns false when the enumeration is over.
+struct SolutionEnumerator {
+    SolutionEnumerator(const EnumerationTables& tables, const SolutionCallback& callback, const int& max_solution_num):
+        tables(tables), callback(callback), max_solution_num(max_solution_num), solution_num(0) {}
+
+    bool Search(const RubikCube3Cubie& cubie, const int& depth, const int& last_face) {
+        if (depth == 0) {
+            if (!cubie.IsSolved())
+                return true;
+            std::string moves;
+            for (int i = 0; i < path.size(); i ++)
+                moves += ((i > 0)? " ": "") + move_strings[path[i]];
+            solution_num ++;
+            return callback(moves) && solution_num != max_solution_num;
+        }
+        if (tables.GetDist(cubie) > depth)
+            return true;
+
+        for (int m = 0; m < face_move_num; m ++) {
+            const int face = m / 3;
+            if (face == last_face || (last_face >= 0 && face == opposite_faces[last_face] && face < last_face))
+                continue;
+
+            RubikCube3Cubie next = cubie;
+            next.Move(m);
+            path.push_back(m);
+            const bool is_continued = Search(next, depth - 1, face);
+            path.pop_back();
+            if (!is_continued)
+                return false;
+        }
+        return true;
+    }
+
+    const EnumerationTables& tables;
+    const SolutionCallback& callback;
+    const int& max_solution_num;
+    std::string move_strings[face_move_num];
+    std::vector<int> path;
+    int solution_num;
+};
+
+
+void RubikCubeSolver::CheckProgress(const bool& is_progressed, const char* step) {
+    if (is_progressed)
+        return;
+    std::cerr << "No way on from the " << step << " step, the cube is invalid" << std::endl;
+    std::abort();
+}
+
+
+int RubikCubeSolver::DoSolveAll(const int& max_length, const SolutionCallback& callback, const int& max_solution_num) {
+    if (max_solution_num == 0)
+        return 0;
+
+    if (cube_.GetDim() != 3) {
+        RubikCube cube = cube_;
+        std::string moves = DoSolve();
+        cube_ = cube;
+        int move_num = 0;
+        for (int i = 0; i < moves.length(); i ++)
+            move_num += (moves[i] != ' ' && (i == 0 || moves[i - 1] == ' '));
+        if (move_num > max_length)
+            return 0;
+        callback(moves);
+        return 1;
+    }
+
+    SolutionEnumerator enumerator(GetEnumerationTables(), callback, max_solution_num);
+    // Turns of the cube's faces in its own orientation, as MoveCube gives them out
+    for (int m = 0; m < face_move_num; m ++)
+        enumerator.move_strings[m] = std::string(1, cube_.GetMappedFaceChar((CUBE_FACE)(m / 3))) + turn_suffixes[m % 3];
+    enumerator.path.reserve(max_length);
+
+    RubikCube3Cubie cubie(cube_);
+    for (int depth = enumerator.tables.GetDist(cubie); depth <= max_length; depth ++)
+        if (!enumerator.Search(cubie, depth, -1))
+            break;
+
+    return enumerator.solution_num;
+}
+
+
+// Depth-first search over short face turn sequences from an observed state, for one
+// which takes it to any state the rest of a plan goes through
+struct PlanReconnector {
+    // Whether colors, moved by the path so far, are solved by the plan from some state
+    // after it, keeping the shortest path and plan rest
+    void Check(const char* colors) {
+        for (int k = suffix_perms.size() - 1; k >= 0; k --) {
+            const int length = path.size() + (suffix_perms.size() - 1 - k);
+            if (length >= best_length)
+                break;
+            // Nearly all states are off by the first few facelets, so those are checked
+            // with early exits before the whole cube
+            const RubikCubePermutation& perm = suffix_perms[k];
+            if (colors[perm[1]] != colors[perm[0]] || colors[perm[2]] != colors[perm[0]])
+                continue;
+            if (perm.IsSolving(colors)) {
+                best_length = length;
+                best_path = path;
+                best_suffix = k;
+                break;
+            }
+        }
+    }
+
+    void Search(const char* colors, const int& depth, const int& last_face) {
+        Check(colors);
+        if (depth == 0 || path.size() >= best_length)
+            return;
+
+        char moved[6 * 5 * 5];
+        for (int m = 0; m < face_move_num; m ++) {
+            const int face = m / 3;
+            if (face == last_face || (last_face >= 0 && face == opposite_faces[last_face] && face < last_face))
+                continue;
+
+            move_perms[m].Apply(colors, moved);
+            path.push_back(m);
+            Search(moved, depth - 1, face);
+            path.pop_back();
+        }
+    }
+
+    std::vector<RubikCubePermutation> suffix_perms;     // of the plan from each state on
+    std::vector<RubikCubePermutation> move_perms;
+    std::vector<int> path;
+    std::vector<int> best_path;
+    int best_suffix;
+    int best_length;
+};
+
+
+std::string RubikCubeSolver::Solve(const RubikCube& from, const RubikCube& to, bool* is_reachable/* = NULL*/) {
+    assert(from.GetDim() == cube_.GetDim() && to.GetDim() == cube_.GetDim());
+    const int dim = cube_.GetDim();
+    RubikCube from_cube = from, to_cube = to;
+    const std::string from_colors = from_cube.GetCubeString(true);
+    const std::string to_colors = to_cube.GetCubeString(true);
+
+    // Facelet i of to holds the piece of facelet transition[i] of from, so the relabeled
+    // from is the solved cube taken back through the transition
+    RubikCubePermutation transition(dim);
+    const std::string solved_colors = RubikCube(dim).GetCubeString(true);
+    std::string colors(solved_colors.length(), ' ');
+    bool is_valid = RubikCubePermutation::GetTransition(from_colors.c_str(), to_colors.c_str(), dim, transition);
+    if (is_valid) {
+        transition.GetInverse().Apply(solved_colors.c_str(), &colors[0]);
+        // Bad cubes must never reach a solver, they could make it hang
+        is_valid = (ValidateCube(colors, dim) == CUBE_STATE_VALID);
+    }
+
+    if (is_reachable)
+        *is_reachable = is_valid;
+    return is_valid? Solve(RubikCube(colors.c_str(), dim)): "";
+}
+
+
+std::string RubikCubeSolver::Resolve(const std::string& solution, const int& executed_num, const RubikCube& observed,
+                                     const int& max_depth/* = resolve_max_depth*/, bool* is_reconnected/* = NULL*/) {
+    assert(observed.GetDim() == cube_.GetDim());
+    const int dim = cube_.GetDim();
+    std::vector<std::string> plan_moves;
+    std::istringstream tokens(solution);
+    std::string token;
+    while (tokens >> token)
+        plan_moves.push_back(token);
+    assert(executed_num >= 0 && executed_num <= plan_moves.size());
+
+    PlanReconnector reconnector;
+    const int suffix_num = plan_moves.size() - executed_num + 1;
+    reconnector.suffix_perms.assign(suffix_num, RubikCubePermutation(dim));
+    for (int k = suffix_num - 2; k >= 0; k --) {
+        reconnector.suffix_perms[k] = RubikCubePermutation::Compile(plan_moves[executed_num + k], dim);
+        reconnector.suffix_perms[k].Multiply(reconnector.suffix_perms[k + 1]);
+    }
+    for (int m = 0; m < face_move_num; m ++)
+        reconnector.move_perms.push_back(RubikCubePermutation::Compile(
+            std::string(1, move_chars[m / 3]) + turn_suffixes[m % 3], dim));
+    reconnector.best_length = max_depth + suffix_num;
+    reconnector.best_suffix = -1;
+
+    RubikCube cube = observed;
+    std::string colors = cube.GetCubeString();
+    reconnector.Search(colors.c_str(), max_depth, -1);
+
+    if (is_reconnected)
+        *is_reconnected = (reconnector.best_suffix >= 0);
+    if (reconnector.best_suffix < 0)
+        return Solve(observed);
+
+    std::string moves;
+    for (int i = 0; i < reconnector.best_path.size(); i ++)
+        moves += std::string(1, move_chars[reconnector.best_path[i] / 3]) + turn_suffixes[reconnector.best_path[i] % 3] + " ";
+    for (int i = executed_num + reconnector.best_suffix; i < plan_moves.size(); i ++)
+        moves += plan_moves[i] + " ";
+    return cube.CompressMoves(moves);
+}
+
+
+RubikCubeSolver* rb::CreateSolver(const std::string& name, int& dim) {
+    dim = 3;
+    if (name == "basic")
+        return new RubikCube3BasicSolver();
+    if (name == "cfop")
+        return new RubikCube3CFOPSolver();
+    if (name == "thistlethwaite")
+        return new RubikCube3ThistlethwaiteSolver();
+    if (name == "bidirectional")
+        return new RubikCube3BidirectionalSolver();
+    if (name == "pocket") {
+        dim = 2;
+        return new RubikCube2OptimalSolver();
+    }
+    return NULL;
+}
@@ -16,34 +16,93 @@
 #pragma once
 
 #include "rubik_cube.hpp"
+#include "rubik_cube_permutation.hpp"
+#include "rubik_cube_metric.hpp"
+#include "rubik_cube_table_memory.hpp"
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
 #include <cstring>
 #include <cctype>
 #include <cassert>
 
 namespace rb {
 
+// Turns searched by Resolve to get back to a plan, 2 take well under a millisecond
+static const int resolve_max_depth = 2;
+
+// Gets every solution SolveAll finds, returns false to stop the search
+typedef std::function<bool(const std::string& moves)> SolutionCallback;
+
 class RubikCubeSolver {
   public:
+    explicit RubikCubeSolver(const int& dim): cube_(dim) {}
     RubikCubeSolver(const RubikCube& cube): cube_(cube) {}
     virtual ~RubikCubeSolver() {}
 
     std::string Solve() { return DoSolve(); }
 
+    // Load another cube and solve it, the solver and its buffers are reused.
+    std::string Solve(const RubikCube& cube) { Reset(cube); return DoSolve(); }
+    void Reset(const RubikCube& cube) { assert(cube.GetDim() == cube_.GetDim()); cube_ = cube; }
+
+    // Moves which turn from into to, e.g. into a pattern, up to turning the whole cube.
+    // The pieces are relabeled so that to is solved, and the relabeled from, to^-1 * from,
+    // is solved once like Solve(cube), with the same tables and searches. When to can't
+    // be reached from from, e.g. it has other pieces or a flipped edge, the relabeled cube
+    // fails ValidateCube and isn't solved: an empty string is returned, like for equal
+    // cubes, and is_reachable tells which it was.
+    std::string Solve(const RubikCube& from, const RubikCube& to, bool* is_reachable = NULL);
+
+    // Stream solutions of up to max_length moves to callback, shortest first, until
+    // max_solution_num of them (all if negative) or callback returns false.
+    // Returns the number of solutions streamed.
+    int SolveAll(const RubikCube& cube, const int& max_length, const SolutionCallback& callback,
+                 const int& max_solution_num = -1) {
+        Reset(cube);
+        return DoSolveAll(max_length, callback, max_solution_num);
+    }
+
+    // Re-plan a solution which went off while executed: executed_num moves of solution
+    // were done, but the cube is observed in another state, e.g. after slipped turns.
+    // Up to max_depth face turns are searched to reconnect to any later state of the plan,
+    // and the shortest reconnection and the rest of the plan is returned. Only when none
+    // is found, observed is solved from scratch, and is_reconnected tells which it was.
+    std::string Resolve(const std::string& solution, const int& executed_num, const RubikCube& observed,
+                        const int& max_depth = resolve_max_depth, bool* is_reconnected = NULL);
+
     char GetUpFaceChar() { return cube_.GetMappedFaceChar(U); }
 
+    // Cost of every move, which the solvers choosing between moves by search minimize.
+    // HTM unless set.
+    void SetMetric(const RubikCubeMetric& metric) { metric_ = metric; }
+    const RubikCubeMetric& GetMetric() const { return metric_; }
+
   private:
-    RubikCubeSolver(const RubikCubeSolver& other) {}
-    RubikCubeSolver& operator=(const RubikCubeSolver& other) {}
+    RubikCubeSolver(const RubikCubeSolver& other);
+    RubikCubeSolver& operator=(const RubikCubeSolver& other);
 
     virtual std::string DoSolve() = 0;
+    // For 3x3x3 cubes, every face turn sequence which isn't shortened by merging or
+    // cancelling turns once commuting turns are reordered, each in one order only.
+    // The search is depth-first with fixed size pruning tables, so it takes no memory
+    // growing with the solutions, and is meant for cubes within about 10 moves.
+    // For other cubes, just the solution of DoSolve when short enough.
+    virtual int DoSolveAll(const int& max_length, const SolutionCallback& callback, const int& max_solution_num);
 
   protected:
     virtual std::string MoveCube(const std::string& moves) {
         std::string ret_moves;
 
-        cube_.Move(moves);
+        // Solvers apply the same algorithms over and over, so compile them once.
+        // A single turn is cheaper to apply directly than to look up.
+        if (moves.find(' ') != std::string::npos)
+            cube_.Move(RubikCubePermutation::Compile(moves, cube_.GetDim()));
+        else
+            cube_.Move(moves);
 
         for (int i = 0; i < moves.length(); i ++) {
             CUBE_FACE face = CvtFaceCharToFace(std::toupper(moves[i]));
@@ -58,11 +117,49 @@ class RubikCubeSolver {
         return ret_moves;
     }
 
+    // Every step of a valid cube has a way on by its tables. One without, from a cube which
+    // never went through ValidateCube, would loop forever, asserts or not, so the solve
+    // stops there.
+    static void CheckProgress(const bool& is_progressed, const char* step);
+
+    // Cost of turning a face of the current orientation, as MoveCube gives the turn out
+    double GetMoveCost(const CUBE_FACE& face, const int& turn) {
+        return metric_.GetMoveCost(cube_.GetMappedFaceChar(face), turn);
+    }
+
     RubikCube cube_;
+    RubikCubeMetric metric_;
+};
+
+static const int pocket_interleave_num = 8;
+
+class RubikCube2OptimalSolver: public RubikCubeSolver {
+  public:
+    RubikCube2OptimalSolver(): RubikCubeSolver(2) {}
+    RubikCube2OptimalSolver(const RubikCube& cube):
+        RubikCubeSolver(cube) { assert(cube_.GetDim() == 2); }
+
+    // Map the distance table of all 3,674,160 states (918,540 bytes) from path,
+    // building and saving it first if the file doesn't exist. Without a loaded
+    // table, it is built in memory on the first solve.
+    // With huge pages or NUMA replication in options, the table is read into memory
+    // placed so instead, and every thread looks up the copy of its own node.
+    static bool LoadTable(const std::string& path, const TableMemoryOptions& options = TableMemoryOptions());
+
+    // Solve many cubes on this thread with the same solutions as Solve(cube), interleaving
+    // interleave_num solves round-robin. The table lines the next move of a solve reads are
+    // prefetched, then the other solves are advanced while they arrive from memory.
+    void SolveBatch(const std::vector<RubikCube>& cubes, std::vector<std::string>& solutions,
+                    const int& interleave_num = pocket_interleave_num);
+
+  private:
+    std::string DoSolve();
+    void StartSolve(int& perm, int& twist, double* move_costs, char* face_chars);
 };
 
 class RubikCube3BasicSolver: public RubikCubeSolver {
   public:
+    RubikCube3BasicSolver(): RubikCubeSolver(3) {}
     RubikCube3BasicSolver(const RubikCube& cube):
         RubikCubeSolver(cube) { assert(cube_.GetDim() == 3); }
 
@@ -93,10 +190,135 @@ class RubikCube3BasicSolver: public RubikCubeSolver {
     inline bool IsCrossOriented(const CUBE_FACE& f);
     inline bool IsCornerOriented(const CUBE_FACE& f);
 
-    inline bool IsDownCornerMatched();
+    // corner 0 is DLF, then DFR, DRB, DBL
+    inline bool IsDownCornerMatched(const int& corner = 0);
     inline int GetDownCornerMatchCount();
 
     void FindBestCubeOrientation();
 };
 
+class RubikCube3CFOPSolver: public RubikCubeSolver {
+  public:
+    RubikCube3CFOPSolver(): RubikCubeSolver(3) {}
+    RubikCube3CFOPSolver(const RubikCube& cube):
+        RubikCubeSolver(cube) { assert(cube_.GetDim() == 3); }
+
+    // Step 1: Down Cross
+    bool IsCrossSolved();
+    std::string SolveCross();
+
+    // Step 2: First Two Layers
+    bool IsF2LSolved();
+    std::string SolveF2L();
+
+    // Step 3: Orient Last Layer
+    bool IsLastLayerOriented();
+    std::string SolveOLL();
+
+    // Step 4: Permute Last Layer
+    bool IsLastLayerPermuted();
+    std::string SolvePLL();
+
+  private:
+    std::string DoSolve();
+
+    inline int GetF2LSolvedMask();
+    inline int GetFrontRightPairCost();
+    std::string SolveFrontRightPair();
+};
+
+class RubikCube3ThistlethwaiteSolver: public RubikCubeSolver {
+  public:
+    RubikCube3ThistlethwaiteSolver(): RubikCubeSolver(3) {}
+    RubikCube3ThistlethwaiteSolver(const RubikCube& cube):
+        RubikCubeSolver(cube) { assert(cube_.GetDim() == 3); }
+
+    // Phase 1: G0 -> G1 = <U, D, L, R, F2, B2>, orient edges
+    bool IsInG1();
+    std::string SolveG1();
+
+    // Phase 2: G1 -> G2 = <U, D, L2, R2, F2, B2>, orient corners and place E-slice edges
+    bool IsInG2();
+    std::string SolveG2();
+
+    // Phase 3: G2 -> G3 = <U2, D2, L2, R2, F2, B2>, place corner tetrads and M/S-slice edges
+    bool IsInG3();
+    std::string SolveG3();
+
+    // Phase 4: G3 -> G4 = {I}, solve by half turns only
+    bool IsInG4();
+    std::string SolveG4();
+
+  private:
+    std::string DoSolve();
+
+    // Cost of every phase move in the current metric
+    void GetPhaseMoveCosts(const std::vector<int>& phase_moves, std::vector<double>& move_costs);
+
+    std::vector<int> path_;     // search scratch, kept across solves
+    std::vector<double> move_costs_;
+};
+
+static const uint64_t bidirectional_max_memory = 256 << 20;
+// Enough for every cube within 10 moves, far cubes fall back after about 40k states
+static const uint64_t bidirectional_max_node_num = 1 << 16;
+
+class RubikCube3BidirectionalSolver: public RubikCubeSolver {
+  public:
+    // Search from the cube until it reaches a table of the states near the solved state,
+    // which finds an optimal solution quickly for cubes within about 10 moves. The table
+    // takes up to half of max_memory, is built on the first solve (about 3 s with the
+    // default budget) and is shared by all the solvers with the same depth of it. When
+    // the next layer of the search is predicted not to fit in the rest, or to take the
+    // search past max_node_num states, the cube is solved by fallback instead, or by a
+    // RubikCube3ThistlethwaiteSolver if it is NULL.
+    explicit RubikCube3BidirectionalSolver(const uint64_t& max_memory = bidirectional_max_memory,
+                                           RubikCubeSolver* fallback = NULL):
+        RubikCubeSolver(3), max_memory_(max_memory), max_node_num_(bidirectional_max_node_num),
+        fallback_(fallback), is_fallen_back_(false) {}
+    RubikCube3BidirectionalSolver(const RubikCube& cube, const uint64_t& max_memory = bidirectional_max_memory,
+                                  RubikCubeSolver* fallback = NULL):
+        RubikCubeSolver(cube), max_memory_(max_memory), max_node_num_(bidirectional_max_node_num),
+        fallback_(fallback), is_fallen_back_(false) {
+        assert(cube_.GetDim() == 3);
+    }
+
+    // Whether the last solve was handed to the fallback solver
+    bool IsFallenBack() const { return is_fallen_back_; }
+    // States the search may generate before handing the cube over, which bounds the
+    // time spent on cubes too far to reach
+    void SetMaxNodeNum(const uint64_t& max_node_num) { max_node_num_ = max_node_num; }
+
+  private:
+    std::string DoSolve();
+    std::string Fallback();
+
+    uint64_t max_memory_;
+    uint64_t max_node_num_;
+    RubikCubeSolver* fallback_;
+    std::unique_ptr<RubikCubeSolver> default_fallback_;
+    bool is_fallen_back_;
+};
+
+// New solver by name: basic, cfop, thistlethwaite, bidirectional or pocket, NULL for
+// any other. dim gets the dimension of the cubes it solves.
+RubikCubeSolver* CreateSolver(const std::string& name, int& dim);
+
+struct RubikCube3Cubie;
+
+// Coordinates of a 3x3x3 cube which bound the face turns solving it, as SolveAll
+// prunes by: corner twists, edge flips, E-slice edge positions and corner permutation
+struct MinMoveCoords {
+    unsigned short co;
+    unsigned short eo;
+    unsigned short slice;
+    unsigned short cp;
+};
+
+void GetMinMoveCoords(const RubikCube3Cubie& cubie, MinMoveCoords& coords);
+// next gets the coordinates after face turn m, without going through a cubie
+void MoveMinMoveCoords(const MinMoveCoords& coords, const int& m, MinMoveCoords& next);
+// Lower bound of the face turns solving a cube with the coordinates
+int GetMinMoveNum(const MinMoveCoords& coords);
+
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_table_memory.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+using namespace rb;
+
+static const size_t default_huge_page_size = 2 << 20;
+
+
+// Default huge page size from /proc/meminfo, "Hugepagesize:    2048 kB"
+static size_t GetHugePageSize() {
+    static const size_t huge_page_size = [] {
+        size_t size = default_huge_page_size;
+        FILE *fp = std::fopen("/proc/meminfo", "r");
+        if (!fp)
+            return size;
+        char line[256];
+        unsigned long kb;
+        while (std::fgets(line, sizeof(line), fp))
+            if (std::sscanf(line, "Hugepagesize: %lu kB", &kb) == 1)
+                size = kb << 10;
+        std::fclose(fp);
+        return size;
+    }();
+    return huge_page_size;
+}
+
+
+// Tables are allocated in whole huge pages whatever they get, so they can be freed alike
+inline size_t GetMappedSize(const size_t& size) {
+    const size_t huge_page_size = GetHugePageSize();
+    return (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+
+// Parse a sysfs list like "0-3,8,10-11" into a bit per number
+static bool ReadSysList(const char* path, uint64_t* bits, const int& bit_num) {
+    FILE *fp = std::fopen(path, "r");
+    if (!fp)
+        return false;
+    std::memset(bits, 0, ((bit_num + 63) / 64) * sizeof(uint64_t));
+    int first, last;
+    bool is_read = false;
+    while (std::fscanf(fp, "%d", &first) == 1) {
+        last = first;
+        int c = std::fgetc(fp);
+        if (c == '-') {
+            if (std::fscanf(fp, "%d", &last) != 1)
+                break;
+            c = std::fgetc(fp);
+        }
+        for (int i = first; i <= last && i < bit_num; i ++)
+            bits[i / 64] |= 1ULL << (i % 64);
+        is_read = true;
+        if (c != ',')
+            break;
+    }
+    std::fclose(fp);
+    return is_read;
+}
+
+
+void* rb::AllocTableMemory(const size_t& size, const HUGE_PAGE_MODE& huge_pages, const int& node,
+                           HUGE_PAGE_MODE* page_mode/* = NULL*/) {
+    const size_t huge_page_size = GetHugePageSize();
+    const size_t mapped_size = GetMappedSize(size);
+    HUGE_PAGE_MODE mode = huge_pages;
+
+    void *mem = MAP_FAILED;
+    if (mode == EXPLICIT_HUGE_PAGES) {
+        mem = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED)
+            mode = TRANSPARENT_HUGE_PAGES;
+    }
+    if (mem == MAP_FAILED) {
+        // Map a huge page more and trim it, so the table starts on a huge page boundary
+        char *raw = (char*)mmap(NULL, mapped_size + huge_page_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return NULL;
+        char *aligned = (char*)(((uintptr_t)raw + huge_page_size - 1) & ~(uintptr_t)(huge_page_size - 1));
+        if (aligned > raw)
+            munmap(raw, aligned - raw);
+        munmap(aligned + mapped_size, raw + huge_page_size - aligned);
+        mem = aligned;
+
+        if (mode == TRANSPARENT_HUGE_PAGES && madvise(mem, mapped_size, MADV_HUGEPAGE) != 0)
+            mode = NO_HUGE_PAGES;
+    }
+
+    // Bind before the pages are touched, they are then placed on node when first written
+    if (node >= 0 && node < max_numa_node_num && GetNumaNodeNum() > 1) {
+        unsigned long node_mask[max_numa_node_num / (8 * sizeof(unsigned long))] = {0};
+        node_mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+        syscall(SYS_mbind, mem, mapped_size, MPOL_BIND, node_mask, max_numa_node_num + 1, 0);
+    }
+
+    if (page_mode)
+        *page_mode = mode;
+    return mem;
+}
+
+
+void rb::FreeTableMemory(void* mem, const size_t& size) {
+    if (mem)
+        munmap(mem, GetMappedSize(size));
+}
+
+
+int rb::GetNumaNodeNum() {
+    static const int node_num = [] {
+        uint64_t nodes[(max_numa_node_num + 63) / 64];
+        if (!ReadSysList("/sys/devices/system/node/online", nodes, max_numa_node_num))
+            return 1;
+        int num = 1;
+        for (int i = 0; i < max_numa_node_num; i ++)
+            if (nodes[i / 64] & (1ULL << (i % 64)))
+                num = i + 1;
+        return num;
+    }();
+    return node_num;
+}
+
+
+static thread_local int current_numa_node = -1;
+
+
+int rb::GetCurrentNumaNode() {
+    if (current_numa_node < 0) {
+        unsigned cpu = 0, node = 0;
+        if (GetNumaNodeNum() == 1 || syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= max_numa_node_num)
+            node = 0;
+        current_numa_node = node;
+    }
+    return current_numa_node;
+}
+
+
+bool rb::PinThreadToNumaNode(const int& node) {
+    if (node < 0 || node >= GetNumaNodeNum())
+        return false;
+
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    uint64_t cpus[(CPU_SETSIZE + 63) / 64];
+    if (!ReadSysList(path, cpus, CPU_SETSIZE)) {
+        // No node directories on a kernel without NUMA, node 0 is the whole machine
+        return node == 0;
+    }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int i = 0; i < CPU_SETSIZE; i ++)
+        if (cpus[i / 64] & (1ULL << (i % 64)))
+            CPU_SET(i, &cpu_set);
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+        return false;
+
+    current_numa_node = node;
+    return true;
+}
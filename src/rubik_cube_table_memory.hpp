@@ -0,0 +1,57 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+
+
+namespace rb {
+
+// Memory placement of big lookup tables on Linux: huge pages to save TLB misses, and
+// NUMA nodes to keep lookups local. Everything falls back to what the machine has,
+// so a single node box without reserved huge pages just gets normal pages on node 0.
+
+enum HUGE_PAGE_MODE {
+    NO_HUGE_PAGES = 0,
+    TRANSPARENT_HUGE_PAGES,     // madvise(MADV_HUGEPAGE), when THP is enabled
+    EXPLICIT_HUGE_PAGES,        // MAP_HUGETLB, from pages reserved in vm.nr_hugepages
+};
+
+struct TableMemoryOptions {
+    TableMemoryOptions(): huge_pages(NO_HUGE_PAGES), is_numa_replicated(false) {}
+
+    HUGE_PAGE_MODE huge_pages;
+    bool is_numa_replicated;    // a copy of the table on every NUMA node
+};
+
+static const int max_numa_node_num = 64;
+
+// Anonymous memory for a table of size bytes, bound to node unless it is negative.
+// Explicit huge pages fall back to transparent ones, and those to normal pages.
+// page_mode gets the pages the memory got. Returns NULL when out of memory.
+void* AllocTableMemory(const size_t& size, const HUGE_PAGE_MODE& huge_pages, const int& node,
+                       HUGE_PAGE_MODE* page_mode = NULL);
+void FreeTableMemory(void* mem, const size_t& size);
+
+// Number of NUMA nodes, 1 without NUMA or when unknown
+int GetNumaNodeNum();
+// Node of the CPU running the calling thread, 0 when unknown. It is looked up once
+// per thread, so it stays right for threads pinned by PinThreadToNumaNode.
+int GetCurrentNumaNode();
+// Run the calling thread only on the CPUs of node
+bool PinThreadToNumaNode(const int& node);
+
+}
@@ -0,0 +1,148 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_trace.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+using namespace rb;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    bool is_instant;
+};
+
+struct TraceBuffer {
+    explicit TraceBuffer(const int& tid): tid(tid), event_num(0) {}
+
+    int tid;
+    std::atomic<uint64_t> event_num;    // events ever recorded, the latest ones are kept
+    TraceEvent events[trace_buffer_size];
+};
+
+// Buffers of all threads, kept after their threads exit so they can still be exported
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceBuffer> > buffers;
+};
+
+
+static TraceRegistry& GetTraceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+
+static TraceBuffer& GetThreadTraceBuffer() {
+    thread_local std::shared_ptr<TraceBuffer> buffer;
+    if (!buffer) {
+        TraceRegistry &registry = GetTraceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer = std::make_shared<TraceBuffer>(registry.buffers.size() + 1);
+        registry.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+
+uint64_t rb::GetTraceTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void RecordEvent(const char* name, const uint64_t& start_ns, const uint64_t& duration_ns,
+                        const bool& is_instant) {
+    TraceBuffer &buffer = GetThreadTraceBuffer();
+    // Only this thread writes the buffer, the release store publishes the event to exporters
+    const uint64_t event_num = buffer.event_num.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer.events[event_num % trace_buffer_size];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    event.is_instant = is_instant;
+    buffer.event_num.store(event_num + 1, std::memory_order_release);
+}
+
+
+void rb::RecordTraceEvent(const char* name, const uint64_t& start_ns, const uint64_t& duration_ns) {
+    RecordEvent(name, start_ns, duration_ns, false);
+}
+
+
+void rb::RecordTraceInstant(const char* name) {
+    RecordEvent(name, GetTraceTime(), 0, true);
+}
+
+
+static void WriteJSONString(FILE* fp, const char* str) {
+    std::fputc('"', fp);
+    for (; *str; str ++) {
+        if (*str == '"' || *str == '\\')
+            std::fputc('\\', fp);
+        if ((unsigned char)*str >= 0x20)
+            std::fputc(*str, fp);
+    }
+    std::fputc('"', fp);
+}
+
+
+bool rb::ExportTrace(const std::string& path) {
+    FILE *fp = std::fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+
+    TraceRegistry &registry = GetTraceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Chrome trace timestamps are in microseconds
+    std::fprintf(fp, "{\"traceEvents\":[");
+    bool is_first = true;
+    for (int i = 0; i < registry.buffers.size(); i ++) {
+        const TraceBuffer &buffer = *registry.buffers[i];
+        const uint64_t event_num = buffer.event_num.load(std::memory_order_acquire);
+        const uint64_t first_event = (event_num > trace_buffer_size)? (event_num - trace_buffer_size): 0;
+        for (uint64_t e = first_event; e < event_num; e ++) {
+            const TraceEvent &event = buffer.events[e % trace_buffer_size];
+            std::fprintf(fp, "%s\n{\"name\":", (is_first)? "": ",");
+            WriteJSONString(fp, event.name);
+            if (event.is_instant)
+                std::fprintf(fp, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", event.start_ns / 1000.0);
+            else
+                std::fprintf(fp, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                             event.start_ns / 1000.0, event.duration_ns / 1000.0);
+            std::fprintf(fp, ",\"pid\":1,\"tid\":%d}", buffer.tid);
+            is_first = false;
+        }
+    }
+    std::fprintf(fp, "\n]}\n");
+
+    return std::fclose(fp) == 0;
+}
+
+
+void rb::ClearTrace() {
+    TraceRegistry &registry = GetTraceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (int i = 0; i < registry.buffers.size(); i ++)
+        registry.buffers[i]->event_num.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,69 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+
+namespace rb {
+
+// Tracing of cube moves and solver phases, compiled in only with -DRB_TRACE
+// (cmake -DRUBIK_CUBE_TRACE=ON). Otherwise the RB_TRACE_* macros expand to nothing.
+//
+// Every thread records into its own ring buffer without locks, keeping its latest
+// trace_buffer_size events. ExportTrace writes the events of all threads in Chrome
+// trace JSON, which chrome://tracing and Perfetto open.
+
+static const int trace_buffer_size = 1 << 16;
+
+uint64_t GetTraceTime();
+
+// name must outlive the trace, e.g. a string literal, only the pointer is kept
+void RecordTraceEvent(const char* name, const uint64_t& start_ns, const uint64_t& duration_ns);
+void RecordTraceInstant(const char* name);
+
+// Export and clear are meant for when the traced threads are idle,
+// events being recorded meanwhile may be partly written or lost
+bool ExportTrace(const std::string& path);
+void ClearTrace();
+
+class TraceScope {
+  public:
+    explicit TraceScope(const char* name): name_(name), start_ns_(GetTraceTime()) {}
+    ~TraceScope() { RecordTraceEvent(name_, start_ns_, GetTraceTime() - start_ns_); }
+
+  private:
+    TraceScope(const TraceScope& other);
+    TraceScope& operator=(const TraceScope& other);
+
+    const char* name_;
+    uint64_t start_ns_;
+};
+
+}
+
+
+#ifdef RB_TRACE
+#define RB_TRACE_CONCAT_IMPL(a, b) a##b
+#define RB_TRACE_CONCAT(a, b) RB_TRACE_CONCAT_IMPL(a, b)
+// Record the time from here to the end of the enclosing block
+#define RB_TRACE_SCOPE(name) rb::TraceScope RB_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define RB_TRACE_INSTANT(name) rb::RecordTraceInstant(name)
+#else
+#define RB_TRACE_SCOPE(name)
+#define RB_TRACE_INSTANT(name)
+#endif
@@ -0,0 +1,229 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_validator.hpp"
+#include "rubik_cube.hpp"
+#include "rubik_cube_3cubie.hpp"
+
+#include <cstring>
+
+using namespace rb;
+
+static const int face_num = UNKNOWN_FACE;
+static const int min_dim = 2;
+static const int max_dim = 5;
+static const int max_facelet_num = face_num * max_dim * max_dim;
+
+
+static const char* cube_state_strings[UNKNOWN_CUBE_STATE] = {
+    "valid",
+    "unsupported dimension",
+    "wrong number of colors",
+    "wrong color counts",
+    "duplicate center colors",
+    "invalid corner",
+    "invalid edge",
+    "twisted corner",
+    "flipped edge",
+    "odd permutation",
+};
+
+
+// Map every facelet to the face whose center has its color. Each pass over
+// the facelets is a plain compare and select over a fixed length, which the
+// compiler vectorizes.
+template <int dim>
+static CUBE_STATE MapFaceletsByCenters(const char* colors, unsigned char* facelet_faces) {
+    const int piece_num = dim * dim;
+    const int facelet_num = face_num * piece_num;
+
+    char center_colors[face_num];
+    for (int f = 0; f < face_num; f ++) {
+        center_colors[f] = colors[f * piece_num + (piece_num >> 1)];
+        for (int g = 0; g < f; g ++)
+            if (center_colors[g] == center_colors[f])
+                return CUBE_STATE_BAD_CENTERS;
+    }
+
+    // Centers are distinct, so if every center color covers piece_num
+    // facelets, all facelets are mapped exactly once
+    for (int f = 0; f < face_num; f ++) {
+        const char center_color = center_colors[f];
+        unsigned char count = 0;
+        for (int i = 0; i < facelet_num; i ++) {
+            const unsigned char match = -(unsigned char)(colors[i] == center_color);
+            count -= match;
+            facelet_faces[i] = (facelet_faces[i] & ~match) | (f & match);
+        }
+        if (count != piece_num)
+            return CUBE_STATE_BAD_COLOR_COUNT;
+    }
+    return CUBE_STATE_VALID;
+}
+
+
+// Even cubes have no fixed centers, so only check for 6 colors with piece_num facelets each.
+static CUBE_STATE CheckColorCounts(const char* colors, const int& dim) {
+    const int piece_num = dim * dim;
+    const int facelet_num = face_num * piece_num;
+
+    int color_counts[256] = {0};
+    for (int i = 0; i < facelet_num; i ++)
+        color_counts[(unsigned char)colors[i]] ++;
+
+    int color_num = 0;
+    for (int c = 0; c < 256; c ++) {
+        if (color_counts[c] == 0)
+            continue;
+        if (color_counts[c] != piece_num)
+            return CUBE_STATE_BAD_COLOR_COUNT;
+        color_num ++;
+    }
+    return (color_num == face_num)? CUBE_STATE_VALID: CUBE_STATE_BAD_COLOR_COUNT;
+}
+
+
+// 2x2x2 facelets of the corners, clockwise from the U/D facelet as in RubikCube3Cubie,
+// and where they are on a 3x3x3 face
+static const int pocket_corner_facelets[8][3] = {
+    {U * 4 + 3, R * 4 + 0, F * 4 + 1}, {U * 4 + 2, F * 4 + 0, L * 4 + 1},
+    {U * 4 + 0, L * 4 + 0, B * 4 + 1}, {U * 4 + 1, B * 4 + 0, R * 4 + 1},
+    {D * 4 + 1, F * 4 + 3, R * 4 + 2}, {D * 4 + 0, L * 4 + 3, F * 4 + 2},
+    {D * 4 + 2, B * 4 + 3, L * 4 + 2}, {D * 4 + 3, R * 4 + 3, B * 4 + 2}
+};
+static const int pocket_dbl_corner = 6;
+static const int idx_3x3[4] = {0, 2, 6, 8};
+
+
+// 2x2x2 cubes have no centers, so the faces are told by the colors of the DBL corner
+// and the colors opposite to them, which never share a corner with them. The corners
+// are then checked like the corners of a 3x3x3 cube around solved edges, except for
+// parity, as the 2x2x2 has no edges to make up for an odd corner permutation.
+static CUBE_STATE ValidatePocketCube(const char* colors) {
+    CUBE_STATE state = CheckColorCounts(colors, 2);
+    if (state != CUBE_STATE_VALID)
+        return state;
+
+    // Colors are numbered by their first facelet, and every color gets a mask of the
+    // colors sharing a corner with it
+    int color_ids[256];
+    int color_num = 0;
+    std::memset(color_ids, -1, sizeof(color_ids));
+    for (int i = 0; i < face_num * 4; i ++) {
+        int &id = color_ids[(unsigned char)colors[i]];
+        if (id < 0)
+            id = color_num ++;
+    }
+
+    int neighbor_masks[face_num] = {0};
+    for (int i = 0; i < 8; i ++) {
+        for (int k = 0; k < 3; k ++) {
+            const int id = color_ids[(unsigned char)colors[pocket_corner_facelets[i][k]]];
+            const int next_id = color_ids[(unsigned char)colors[pocket_corner_facelets[i][(k + 1) % 3]]];
+            if (id == next_id)
+                return CUBE_STATE_BAD_CORNER;
+            neighbor_masks[id] |= 1 << next_id;
+            neighbor_masks[next_id] |= 1 << id;
+        }
+    }
+
+    static const CUBE_FACE dbl_faces[3] = {D, B, L};
+    static const CUBE_FACE far_faces[3] = {U, F, R};
+    int face_ids[face_num];
+    int face_id_mask = 0;
+    for (int k = 0; k < 3; k ++) {
+        const int id = color_ids[(unsigned char)colors[pocket_corner_facelets[pocket_dbl_corner][k]]];
+        const int far_mask = ((1 << face_num) - 1) & ~neighbor_masks[id] & ~(1 << id);
+        if (__builtin_popcount(far_mask) != 1)
+            return CUBE_STATE_BAD_CORNER;
+        face_ids[dbl_faces[k]] = id;
+        face_ids[far_faces[k]] = __builtin_ctz(far_mask);
+        face_id_mask |= (1 << id) | far_mask;
+    }
+    if (face_id_mask != (1 << face_num) - 1)
+        return CUBE_STATE_BAD_CORNER;
+    int id_faces[face_num];
+    for (int f = 0; f < face_num; f ++)
+        id_faces[face_ids[f]] = f;
+
+    unsigned char facelet_faces[face_num * 9];
+    for (int f = 0; f < face_num; f ++) {
+        std::memset(&facelet_faces[f * 9], f, 9);
+        for (int i = 0; i < 4; i ++)
+            facelet_faces[f * 9 + idx_3x3[i]] = id_faces[color_ids[(unsigned char)colors[f * 4 + i]]];
+    }
+
+    RubikCube3Cubie cubie;
+    state = cubie.SetFacelets(facelet_faces);
+    if (state != CUBE_STATE_VALID)
+        return state;
+    state = cubie.Verify();
+    return (state == CUBE_STATE_BAD_PARITY)? CUBE_STATE_VALID: state;
+}
+
+
+static CUBE_STATE ValidateCubeRecord(const char* colors, const int& dim) {
+    if (dim == 2)
+        return ValidatePocketCube(colors);
+    if ((dim & 1) == 0)
+        return CheckColorCounts(colors, dim);
+
+    unsigned char facelet_faces[max_facelet_num];
+    if (dim == 5)
+        return MapFaceletsByCenters<5>(colors, facelet_faces);
+
+    CUBE_STATE state = MapFaceletsByCenters<3>(colors, facelet_faces);
+    if (state != CUBE_STATE_VALID)
+        return state;
+
+    RubikCube3Cubie cubie;
+    state = cubie.SetFacelets(facelet_faces);
+    if (state != CUBE_STATE_VALID)
+        return state;
+    return cubie.Verify();
+}
+
+
+const char* rb::GetCubeStateString(const CUBE_STATE& state) {
+    assert(state >= CUBE_STATE_VALID && state < UNKNOWN_CUBE_STATE);
+    return cube_state_strings[state];
+}
+
+
+CUBE_STATE rb::ValidateCube(const std::string& colors, const int& dim/* = 3*/) {
+    return ValidateCube(colors.data(), colors.length(), dim);
+}
+
+
+CUBE_STATE rb::ValidateCube(const char* colors, const int& len, const int& dim/* = 3*/) {
+    if (dim < min_dim || dim > max_dim)
+        return CUBE_STATE_BAD_DIM;
+    if (len != face_num * dim * dim)
+        return CUBE_STATE_BAD_LENGTH;
+    return ValidateCubeRecord(colors, dim);
+}
+
+
+void rb::ValidateCubes(const char* colors, const int& cube_num, const int& dim, CUBE_STATE* states) {
+    if (dim < min_dim || dim > max_dim) {
+        for (int i = 0; i < cube_num; i ++)
+            states[i] = CUBE_STATE_BAD_DIM;
+        return;
+    }
+
+    const int facelet_num = face_num * dim * dim;
+    for (int i = 0; i < cube_num; i ++)
+        states[i] = ValidateCubeRecord(colors + i * facelet_num, dim);
+}
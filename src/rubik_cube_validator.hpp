@@ -0,0 +1,48 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+
+
+namespace rb {
+
+enum CUBE_STATE {
+    CUBE_STATE_VALID = 0,
+    CUBE_STATE_BAD_DIM,             // dim isn't supported by RubikCube
+    CUBE_STATE_BAD_LENGTH,          // not 6 * dim * dim colors
+    CUBE_STATE_BAD_COLOR_COUNT,     // not 6 colors with dim * dim pieces each
+    CUBE_STATE_BAD_CENTERS,         // two face centers have the same color
+    CUBE_STATE_BAD_CORNER,          // a corner doesn't exist or appears twice
+    CUBE_STATE_BAD_EDGE,            // an edge doesn't exist or appears twice
+    CUBE_STATE_TWISTED_CORNER,      // corner twist sum isn't a multiple of 3
+    CUBE_STATE_FLIPPED_EDGE,        // edge flip sum is odd
+    CUBE_STATE_BAD_PARITY,          // corner and edge permutation parities differ
+    UNKNOWN_CUBE_STATE
+};
+
+const char* GetCubeStateString(const CUBE_STATE& state);
+
+// Check whether colors, in the face order used by RubikCube(colors, dim), can be
+// reached from a solved cube. Colors are checked for every dim, pieces and twist for
+// 2x2x2 and 3x3x3, flip and parity for 3x3x3 only. Nothing is allocated.
+CUBE_STATE ValidateCube(const std::string& colors, const int& dim = 3);
+CUBE_STATE ValidateCube(const char* colors, const int& len, const int& dim = 3);
+
+// Validate cube_num cubes packed back to back, 6 * dim * dim colors each.
+void ValidateCubes(const char* colors, const int& cube_num, const int& dim, CUBE_STATE* states);
+
+}
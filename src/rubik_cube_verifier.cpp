@@ -0,0 +1,61 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_verifier.hpp"
+#include "rubik_cube_permutation.hpp"
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+using namespace rb;
+
+// Below this many cubes per thread, starting threads costs more than it saves
+static const int min_cubes_per_thread = 256;
+
+
+static void VerifyRange(const char* colors, const std::string* moves, const int& begin, const int& end,
+                        const int& dim, bool* results) {
+    const int facelet_num = 6 * dim * dim;
+    for (int i = begin; i < end; i ++)
+        results[i] = RubikCubePermutation(moves[i], dim).IsSolving(colors + i * facelet_num);
+}
+
+
+bool rb::VerifySolution(const char* colors, const std::string& moves, const int& dim/* = 3*/) {
+    return RubikCubePermutation(moves, dim).IsSolving(colors);
+}
+
+
+void rb::VerifySolutions(const char* colors, const std::string* moves, const int& cube_num, const int& dim,
+                         bool* results, const int& thread_num/* = 0*/) {
+    int worker_num = (thread_num > 0)? thread_num: std::thread::hardware_concurrency();
+    worker_num = std::min(worker_num, cube_num / min_cubes_per_thread);
+    if (worker_num <= 1) {
+        VerifyRange(colors, moves, 0, cube_num, dim, results);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    const int cubes_per_worker = (cube_num + worker_num - 1) / worker_num;
+    for (int begin = cubes_per_worker; begin < cube_num; begin += cubes_per_worker) {
+        const int end = std::min(begin + cubes_per_worker, cube_num);
+        workers.push_back(std::thread(VerifyRange, colors, moves, begin, end, dim, results));
+    }
+    VerifyRange(colors, moves, 0, cubes_per_worker, dim, results);
+
+    for (int i = 0; i < workers.size(); i ++)
+        workers[i].join();
+}
@@ -0,0 +1,33 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <string>
+
+
+namespace rb {
+
+// Whether moves solve the cube given by colors, in the face order used by
+// RubikCube(colors, dim). The moves are composed into one facelet permutation
+// and applied once, without constructing a RubikCube.
+bool VerifySolution(const char* colors, const std::string& moves, const int& dim = 3);
+
+// Verify cube_num (cube, moves) pairs, colors packed back to back with
+// 6 * dim * dim colors each. thread_num 0 uses all hardware threads.
+void VerifySolutions(const char* colors, const std::string* moves, const int& cube_num, const int& dim,
+                     bool* results, const int& thread_num = 0);
+
+}
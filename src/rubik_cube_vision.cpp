@@ -0,0 +1,347 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_vision.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+using namespace rb;
+
+static const int face_num = 6;
+static const int max_dim = 5;
+static const int max_sticker_num = face_num * max_dim * max_dim;
+
+// A face smaller than this part of its image is taken for noise
+static const double min_face_area_ratio = 0.1;
+// How far the outline may stray from its quadrilateral, relative to its length
+static const double outline_epsilon_ratio = 0.04;
+// Lighting changes the lightness of a sticker much more than its hue
+static const float lightness_weight = 0.25f;
+static const int cluster_iteration_num = 8;
+// Below this many cubes per thread, starting threads costs more than it saves
+static const int min_cubes_per_thread = 16;
+
+// Default reference colors in BGR, for the colors of vision_color_chars
+static const cv::Vec3b default_reference_colors[face_num] = {
+    cv::Vec3b(255, 255, 255), cv::Vec3b(0, 128, 255), cv::Vec3b(0, 160, 0),
+    cv::Vec3b(0, 0, 200), cv::Vec3b(200, 60, 0), cv::Vec3b(0, 220, 255)
+};
+
+
+// Images of every thread are processed in the same buffers, which keep their
+// memory from one face to the next as long as the image sizes don't change
+struct FaceBuffers {
+    cv::Mat reduced;
+    cv::Mat channels[3];
+    cv::Mat brightness;
+    cv::Mat mask;
+    cv::Mat warped;
+    cv::Mat samples;
+    cv::Mat lab_samples;
+    std::vector<std::vector<cv::Point> > contours;
+    std::vector<cv::Point> outline;
+};
+
+
+static FaceBuffers& GetFaceBuffers() {
+    static thread_local FaceBuffers buffers;
+    return buffers;
+}
+
+
+inline float GetColorDist(const cv::Vec3f& a, const cv::Vec3f& b) {
+    const cv::Vec3f diff = a - b;
+    return lightness_weight * diff[0] * diff[0] + diff[1] * diff[1] + diff[2] * diff[2];
+}
+
+
+// Corners in the order top left, top right, bottom right, bottom left. They are sorted
+// by their angle around the center, so no corner is taken twice however the face is turned.
+static void OrderCorners(cv::Point2f* corners) {
+    const cv::Point2f center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25f;
+    std::sort(corners, corners + 4, [&center](const cv::Point2f& a, const cv::Point2f& b) {
+        return std::atan2(a.y - center.y, a.x - center.x) < std::atan2(b.y - center.y, b.x - center.x);
+    });
+
+    int top_left = 0;
+    for (int i = 1; i < 4; i ++)
+        if (corners[i].x + corners[i].y < corners[top_left].x + corners[top_left].y)
+            top_left = i;
+    std::rotate(corners, corners + top_left, corners + 4);
+}
+
+
+// Mean colors of the dim x dim stickers of the face in image, BGR from 0 to 1
+static bool ReadFace(const cv::Mat& image, const int& dim, FaceBuffers& buffers, cv::Vec3f* bgr_colors) {
+    if (image.empty() || image.type() != CV_8UC3)
+        return false;
+
+    // INTER_AREA would be 5 to 40 times slower at the fractional factors images come in,
+    // and the mean colors of the stickers' middles don't suffer from plain interpolation
+    const int image_size = std::max(image.cols, image.rows);
+    const bool is_reduced = (image_size > vision_work_size);
+    if (is_reduced) {
+        const double scale = (double)vision_work_size / image_size;
+        cv::resize(image, buffers.reduced, cv::Size(), scale, scale, cv::INTER_LINEAR);
+    }
+    const cv::Mat& face = is_reduced? buffers.reduced: image;
+
+    // Stickers are brighter than the background and the gaps in one channel at least,
+    // even the dark ones such as blue
+    cv::split(face, buffers.channels);
+    cv::max(buffers.channels[0], buffers.channels[1], buffers.brightness);
+    cv::max(buffers.brightness, buffers.channels[2], buffers.brightness);
+    cv::threshold(buffers.brightness, buffers.mask, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+
+    // Close the gaps between the stickers, so the face is a single region
+    const int gap_size = std::max(3, std::min(face.cols, face.rows) / (dim * 4)) | 1;
+    cv::morphologyEx(buffers.mask, buffers.mask, cv::MORPH_CLOSE,
+                     cv::getStructuringElement(cv::MORPH_RECT, cv::Size(gap_size, gap_size)));
+
+    cv::findContours(buffers.mask, buffers.contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    int outline_idx = -1;
+    double max_area = min_face_area_ratio * face.cols * face.rows;
+    for (int i = 0; i < buffers.contours.size(); i ++) {
+        const double area = cv::contourArea(buffers.contours[i]);
+        if (area > max_area) {
+            max_area = area;
+            outline_idx = i;
+        }
+    }
+    if (outline_idx < 0)
+        return false;
+
+    // Corners of the outline, or of the smallest rectangle around it when it isn't a
+    // quadrilateral, e.g. with a sticker missing at a corner
+    const std::vector<cv::Point>& contour = buffers.contours[outline_idx];
+    cv::Point2f corners[4];
+    cv::approxPolyDP(contour, buffers.outline, outline_epsilon_ratio * cv::arcLength(contour, true), true);
+    if (buffers.outline.size() == 4 && cv::isContourConvex(buffers.outline)) {
+        for (int i = 0; i < 4; i ++)
+            corners[i] = buffers.outline[i];
+    } else
+        cv::minAreaRect(contour).points(corners);
+    OrderCorners(corners);
+
+    const int side = dim * vision_cell_size;
+    const cv::Point2f square[4] = {
+        cv::Point2f(0, 0), cv::Point2f(side, 0), cv::Point2f(side, side), cv::Point2f(0, side)
+    };
+    cv::warpPerspective(face, buffers.warped, cv::getPerspectiveTransform(corners, square), cv::Size(side, side));
+
+    // The middle of every cell, away from the gaps and the rounded corners of the stickers
+    const int margin = vision_cell_size / 4;
+    for (int r = 0; r < dim; r ++) {
+        for (int c = 0; c < dim; c ++) {
+            const cv::Rect cell(c * vision_cell_size + margin, r * vision_cell_size + margin,
+                                vision_cell_size - 2 * margin, vision_cell_size - 2 * margin);
+            const cv::Scalar mean = cv::mean(buffers.warped(cell));
+            bgr_colors[r * dim + c] = cv::Vec3f(mean[0], mean[1], mean[2]) * (1.0f / 255);
+        }
+    }
+    return true;
+}
+
+
+// Run extract_range over ranges of the cubes across threads, summing the cubes read
+template <typename ExtractRange>
+static int ExtractInThreads(const int& cube_num, const int& thread_num, const ExtractRange& extract_range) {
+    int worker_num = (thread_num > 0)? thread_num: std::thread::hardware_concurrency();
+    worker_num = std::min(worker_num, cube_num / min_cubes_per_thread);
+    if (worker_num <= 1)
+        return extract_range(0, cube_num);
+
+    std::vector<std::thread> workers;
+    std::vector<int> read_nums(worker_num, 0);
+    const int cubes_per_worker = (cube_num + worker_num - 1) / worker_num;
+    for (int i = 1; i * cubes_per_worker < cube_num; i ++) {
+        const int begin = i * cubes_per_worker;
+        const int end = std::min(begin + cubes_per_worker, cube_num);
+        workers.push_back(std::thread([&extract_range, &read_nums, i, begin, end] {
+            read_nums[i] = extract_range(begin, end);
+        }));
+    }
+    read_nums[0] = extract_range(0, cubes_per_worker);
+
+    int read_num = 0;
+    for (int i = 0; i < workers.size(); i ++)
+        workers[i].join();
+    for (int i = 0; i < worker_num; i ++)
+        read_num += read_nums[i];
+    return read_num;
+}
+
+
+RubikCubeVision::RubikCubeVision(const int& dim/* = 3*/):
+    dim_(dim) {
+    assert(dim >= 2 && dim <= max_dim);
+    SetReferenceColors(default_reference_colors);
+}
+
+
+bool RubikCubeVision::Calibrate(const cv::Mat* faces, const char* color_chars/* = vision_color_chars*/) {
+    const int piece_num = dim_ * dim_;
+    FaceBuffers& buffers = GetFaceBuffers();
+    cv::Vec3f bgr_colors[max_dim * max_dim];
+    cv::Mat face_colors(face_num, 1, CV_32FC3);
+    for (int f = 0; f < face_num; f ++) {
+        if (!ReadFace(faces[f], dim_, buffers, bgr_colors))
+            return false;
+        cv::Vec3f sum;
+        for (int i = 0; i < piece_num; i ++)
+            sum += bgr_colors[i];
+        face_colors.at<cv::Vec3f>(f) = sum * (1.0f / piece_num);
+    }
+
+    cv::Mat lab_colors;
+    cv::cvtColor(face_colors, lab_colors, cv::COLOR_BGR2Lab);
+    for (int f = 0; f < face_num; f ++)
+        reference_colors_[f] = lab_colors.at<cv::Vec3f>(f);
+    assert(std::strlen(color_chars) == face_num);
+    std::strcpy(color_chars_, color_chars);
+    return true;
+}
+
+
+void RubikCubeVision::SetReferenceColors(const cv::Vec3b* bgr_colors,
+                                         const char* color_chars/* = vision_color_chars*/) {
+    cv::Mat face_colors(face_num, 1, CV_32FC3), lab_colors;
+    for (int f = 0; f < face_num; f ++)
+        face_colors.at<cv::Vec3f>(f) = cv::Vec3f(bgr_colors[f][0], bgr_colors[f][1], bgr_colors[f][2]) * (1.0f / 255);
+    cv::cvtColor(face_colors, lab_colors, cv::COLOR_BGR2Lab);
+    for (int f = 0; f < face_num; f ++)
+        reference_colors_[f] = lab_colors.at<cv::Vec3f>(f);
+    assert(std::strlen(color_chars) == face_num);
+    std::strcpy(color_chars_, color_chars);
+}
+
+
+bool RubikCubeVision::ExtractColors(const cv::Mat* faces, std::string& colors) const {
+    colors.clear();
+    const int piece_num = dim_ * dim_;
+    FaceBuffers& buffers = GetFaceBuffers();
+    buffers.samples.create(face_num * piece_num, 1, CV_32FC3);
+    for (int f = 0; f < face_num; f ++)
+        if (!ReadFace(faces[f], dim_, buffers, buffers.samples.ptr<cv::Vec3f>(f * piece_num)))
+            return false;
+
+    cv::cvtColor(buffers.samples, buffers.lab_samples, cv::COLOR_BGR2Lab);
+    ClassifyColors(buffers.lab_samples.ptr<cv::Vec3f>(), colors);
+    return true;
+}
+
+
+int RubikCubeVision::ExtractBatch(const cv::Mat* faces, const int& cube_num, std::string* colors,
+                                  const int& thread_num/* = 0*/) const {
+    return ExtractInThreads(cube_num, thread_num, [this, faces, colors](const int& begin, const int& end) {
+        int read_num = 0;
+        for (int i = begin; i < end; i ++)
+            read_num += ExtractColors(&faces[i * face_num], colors[i]);
+        return read_num;
+    });
+}
+
+
+int RubikCubeVision::ExtractFiles(const std::vector<std::string>& paths, std::vector<std::string>& colors,
+                                  const int& thread_num/* = 0*/) const {
+    assert(paths.size() % face_num == 0);
+    const int cube_num = paths.size() / face_num;
+    colors.assign(cube_num, std::string());
+
+    return ExtractInThreads(cube_num, thread_num, [this, &paths, &colors](const int& begin, const int& end) {
+        // Files are read and decoded into the same buffers for all cubes of the range
+        std::vector<unsigned char> bytes;
+        cv::Mat faces[face_num];
+        int read_num = 0;
+        for (int i = begin; i < end; i ++) {
+            bool is_decoded = true;
+            for (int f = 0; f < face_num && is_decoded; f ++) {
+                std::ifstream file(paths[i * face_num + f].c_str(), std::ios::binary);
+                bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                is_decoded = !bytes.empty();
+                if (is_decoded)
+                    cv::imdecode(bytes, cv::IMREAD_COLOR, &faces[f]);
+            }
+            if (is_decoded)
+                read_num += ExtractColors(faces, colors[i]);
+        }
+        return read_num;
+    });
+}
+
+
+void RubikCubeVision::ClassifyColors(const cv::Vec3f* lab_colors, std::string& colors) const {
+    const int piece_num = dim_ * dim_;
+    const int sticker_num = face_num * piece_num;
+
+    // Clustering starts from the reference colors, and every round the stickers are
+    // given to colors from the closest pairs on, each color taking piece_num stickers.
+    // The colors then move to the mean of their stickers, following the lighting.
+    cv::Vec3f centers[face_num];
+    std::copy(reference_colors_, reference_colors_ + face_num, centers);
+    std::pair<float, short> pairs[max_sticker_num * face_num];
+    signed char labels[max_sticker_num], new_labels[max_sticker_num];
+    std::memset(labels, -1, sticker_num);
+
+    for (int round = 0; round < cluster_iteration_num; round ++) {
+        // Mostly every sticker is closest to its own color, which balances by itself
+        int counts[face_num] = {0};
+        bool is_balanced = true;
+        for (int s = 0; s < sticker_num; s ++) {
+            for (int k = 0; k < face_num; k ++) {
+                pairs[s * face_num + k] = std::make_pair(GetColorDist(lab_colors[s], centers[k]), s * face_num + k);
+                if (k == 0 || pairs[s * face_num + k].first < pairs[s * face_num + new_labels[s]].first)
+                    new_labels[s] = k;
+            }
+            is_balanced &= (++ counts[new_labels[s]] <= piece_num);
+        }
+
+        if (!is_balanced) {
+            std::sort(pairs, pairs + sticker_num * face_num);
+            std::memset(counts, 0, sizeof(counts));
+            std::memset(new_labels, -1, sticker_num);
+            for (int i = 0, assigned_num = 0; assigned_num < sticker_num; i ++) {
+                const int s = pairs[i].second / face_num, k = pairs[i].second % face_num;
+                if (new_labels[s] < 0 && counts[k] < piece_num) {
+                    new_labels[s] = k;
+                    counts[k] ++;
+                    assigned_num ++;
+                }
+            }
+        }
+        if (std::memcmp(labels, new_labels, sticker_num) == 0)
+            break;
+        std::memcpy(labels, new_labels, sticker_num);
+
+        cv::Vec3f sums[face_num];
+        for (int s = 0; s < sticker_num; s ++)
+            sums[labels[s]] += lab_colors[s];
+        for (int k = 0; k < face_num; k ++)
+            centers[k] = sums[k] * (1.0f / piece_num);
+    }
+
+    colors.resize(sticker_num);
+    for (int s = 0; s < sticker_num; s ++)
+        colors[s] = color_chars_[labels[s]];
+}
@@ -0,0 +1,77 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <vector>
+
+
+namespace rb {
+
+// Colors of the U, L, F, R, B and D faces of a solved cube in the default reference
+// colors: white, orange, green, red, blue and yellow
+static const char* vision_color_chars = "WOGRBY";
+
+// Faces are reduced to about this many pixels across before their outline is searched
+static const int vision_work_size = 160;
+// Pixels across a sticker once the face is warped square
+static const int vision_cell_size = 16;
+
+// Reads cube colors from camera images, six per cube in the face order of RubikCube
+// (U, L, F, R, B, D), into the colors RubikCube(colors, dim) takes.
+// Every image shows one face, turned as RubikCube::Dump prints it, against a darker
+// background and with dark gaps between the stickers. The outline of the stickers is
+// warped into a square and split into dim x dim cells, so tilted or skewed faces are
+// read as well. The mean colors of the cells are then clustered around the reference
+// colors in CIE Lab, giving every color exactly dim * dim stickers, so a sticker in a
+// glare or shadow still gets the color the other stickers leave to it.
+class RubikCubeVision {
+  public:
+    explicit RubikCubeVision(const int& dim = 3);
+
+    int GetDim() const { return dim_; }
+
+    // Reference colors from the six face images of a solved cube under the lighting
+    // of the camera, named by color_chars. Returns false when a face isn't found.
+    bool Calibrate(const cv::Mat* faces, const char* color_chars = vision_color_chars);
+    // Reference colors in BGR, 0 to 255, named by color_chars
+    void SetReferenceColors(const cv::Vec3b* bgr_colors, const char* color_chars = vision_color_chars);
+
+    // Colors of a cube from its six face images. Returns false, leaving colors empty,
+    // when a face isn't found in its image.
+    bool ExtractColors(const cv::Mat* faces, std::string& colors) const;
+    // Colors of cube_num cubes, faces[6 * i] to faces[6 * i + 5] being cube i, across
+    // threads. thread_num 0 uses all hardware threads. Returns the number of cubes read,
+    // cubes which aren't read get empty colors.
+    int ExtractBatch(const cv::Mat* faces, const int& cube_num, std::string* colors,
+                     const int& thread_num = 0) const;
+    // The same from image files, six paths per cube
+    int ExtractFiles(const std::vector<std::string>& paths, std::vector<std::string>& colors,
+                     const int& thread_num = 0) const;
+
+    // Colors of the 6 * dim * dim stickers of a cube from their mean colors in Lab,
+    // as cv::cvtColor gives for float BGR
+    void ClassifyColors(const cv::Vec3f* lab_colors, std::string& colors) const;
+
+  private:
+    int dim_;
+    cv::Vec3f reference_colors_[6];     // in Lab
+    char color_chars_[7];
+};
+
+}
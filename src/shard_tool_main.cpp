@@ -0,0 +1,108 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_shard_coordinator.hpp"
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+// Solves a file of cubes, a line of colors each, in shards across worker processes,
+// resuming from the checkpoint in the work directory when it's run again.
+// Workers on other machines join with --connect.
+
+static rb::RubikCubeShardCoordinator* g_coordinator = NULL;
+
+static void HandleSignal(int) {
+    if (g_coordinator)
+        g_coordinator->Stop();
+}
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " --input FILE --output FILE --work-dir DIR [--solver NAME]"
+              << " [--shard-lines N] [--workers N] [--listen unix:PATH|PORT]" << std::endl
+              << "       " << prog << " --connect unix:PATH|HOST:PORT" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    rb::ShardJob job;
+    int worker_num = 4;
+    std::string listen_address;
+    std::string connect_address;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--input")
+            job.input_path = argv[i + 1];
+        else if (arg == "--output")
+            job.output_path = argv[i + 1];
+        else if (arg == "--work-dir")
+            job.work_dir = argv[i + 1];
+        else if (arg == "--solver")
+            job.solver = argv[i + 1];
+        else if (arg == "--shard-lines")
+            job.shard_lines = std::atoi(argv[i + 1]);
+        else if (arg == "--workers")
+            worker_num = std::atoi(argv[i + 1]);
+        else if (arg == "--listen")
+            listen_address = argv[i + 1];
+        else if (arg == "--connect")
+            connect_address = argv[i + 1];
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((argc % 2) == 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    if (!connect_address.empty()) {
+        const int shard_num = rb::RunShardWorker(connect_address);
+        if (shard_num < 0) {
+            std::cout << "Failed to work for " << connect_address << std::endl;
+            return 1;
+        }
+        std::cout << "Solved " << shard_num << " shards" << std::endl;
+        return 0;
+    }
+
+    if (job.input_path.empty() || job.output_path.empty() || job.work_dir.empty() ||
+        job.shard_lines <= 0 || worker_num < 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (listen_address.empty())
+        listen_address = "unix:" + job.work_dir + "/coordinator.sock";
+
+    rb::RubikCubeShardCoordinator coordinator(job);
+    if (!coordinator.Listen(listen_address)) {
+        std::cout << "Failed to listen on " << listen_address << std::endl;
+        return 1;
+    }
+
+    g_coordinator = &coordinator;
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    const bool is_done = coordinator.Run(worker_num);
+    g_coordinator = NULL;
+
+    std::cout << coordinator.GetDoneShardNum() << " of " << coordinator.GetShardNum() << " shards done"
+              << (is_done? ", merged into " + job.output_path: ", run again to resume") << std::endl;
+    return is_done? 0: 1;
+}
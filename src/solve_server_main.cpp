@@ -0,0 +1,83 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube_solve_server.hpp"
+
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+static rb::RubikCubeSolveServer* g_server = NULL;
+
+static void HandleSignal(int) {
+    if (g_server)
+        g_server->Stop();
+}
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " (--unix PATH | --tcp PORT) [--workers N] [--queue N] [--batch N] [--numa 0|1]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string unix_path;
+    int tcp_port = 0;
+    int worker_num = 4;
+    int max_queued = 1024;
+    int max_batch = 32;
+    bool is_numa_pinned = false;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--unix")
+            unix_path = argv[i + 1];
+        else if (arg == "--tcp")
+            tcp_port = std::atoi(argv[i + 1]);
+        else if (arg == "--workers")
+            worker_num = std::atoi(argv[i + 1]);
+        else if (arg == "--queue")
+            max_queued = std::atoi(argv[i + 1]);
+        else if (arg == "--batch")
+            max_batch = std::atoi(argv[i + 1]);
+        else if (arg == "--numa")
+            is_numa_pinned = std::atoi(argv[i + 1]) != 0;
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((argc % 2) == 0 || unix_path.empty() == (tcp_port == 0) ||
+        worker_num <= 0 || max_queued <= 0 || max_batch <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    rb::RubikCubeSolveServer server(worker_num, max_queued, max_batch, is_numa_pinned);
+    bool is_listening = unix_path.empty()? server.ListenTcp(tcp_port): server.ListenUnix(unix_path);
+    if (!is_listening) {
+        std::cout << "Failed to listen on " << (unix_path.empty()? std::to_string(tcp_port): unix_path) << std::endl;
+        return 1;
+    }
+
+    g_server = &server;
+    std::signal(SIGINT, HandleSignal);
+    std::signal(SIGTERM, HandleSignal);
+
+    std::cout << "Solve server is running with " << worker_num << " workers" << std::endl;
+    server.Run();
+    g_server = NULL;
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube.hpp"
+#include "rubik_cube_vision.hpp"
+#include "rubik_cube_validator.hpp"
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// Reads cube colors from face images listed in a file, six paths per cube, or renders
+// seeded scrambles into synthetic face images and checks that every cube is read back,
+// reporting cubes per second. Exits with 1 when a synthetic cube is read wrong.
+
+static const int face_num = 6;
+
+// Sticker colors of the synthetic cubes in BGR, a bit off the default reference colors
+static const cv::Vec3b render_colors[face_num] = {
+    cv::Vec3b(235, 235, 235), cv::Vec3b(20, 110, 250), cv::Vec3b(40, 170, 20),
+    cv::Vec3b(30, 20, 190), cv::Vec3b(180, 70, 10), cv::Vec3b(30, 215, 240)
+};
+
+
+static void PrintUsage(const char* prog) {
+    std::cout << "Usage: " << prog << " [--dim 2..5] [--count N] [--seed N] [--size PIXELS] [--noise SIGMA]"
+              << " [--threads N] [--save DIR]" << std::endl
+              << "       " << prog << " --list FILE [--dim 2..5] [--calibrate FILE] [--threads N]" << std::endl;
+}
+
+
+// Only raw std::mt19937 outputs are used, as in rubik-cube-bench-tool
+inline double GetUniform(std::mt19937& rng, const double& low, const double& high) {
+    return low + (high - low) * (rng() / 4294967296.0);
+}
+
+
+static std::string GenerateScramble(std::mt19937& rng, const int& dim, const int& move_num) {
+    static const char* turn_suffixes[3] = {"", "2", "'"};
+    // Inner slices move the pieces outer turns leave in place on bigger cubes
+    const int move_char_num = (dim > 3)? 12: 6;
+    std::string moves;
+    for (int i = 0; i < move_num; i ++) {
+        if (i > 0)
+            moves += ' ';
+        moves += rb::move_chars[rng() % move_char_num];
+        moves += turn_suffixes[rng() % 3];
+    }
+    return moves;
+}
+
+
+// Image of face f of a cube with colors as RubikCube::GetCubeString(true) gives them,
+// turned and skewed at random, under a random light, with noise
+static void RenderFace(const std::string& colors, const int& f, const int& dim, const int& image_size,
+                       const double& noise, std::mt19937& rng, cv::Mat& image) {
+    const int background = 15 + rng() % 20;
+    image.create(image_size, image_size, CV_8UC3);
+    image.setTo(cv::Scalar(background, background, background));
+
+    const double angle = GetUniform(rng, -0.2, 0.2);
+    const double half_side = image_size * GetUniform(rng, 0.3, 0.4);
+    const cv::Point2d center(image_size * GetUniform(rng, 0.45, 0.55), image_size * GetUniform(rng, 0.45, 0.55));
+    cv::Point2d corners[4];
+    for (int i = 0; i < 4; i ++) {
+        const double x = (i == 1 || i == 2)? half_side: -half_side;
+        const double y = (i >= 2)? half_side: -half_side;
+        corners[i] = center + cv::Point2d(x * std::cos(angle) - y * std::sin(angle), x * std::sin(angle) + y * std::cos(angle))
+                   + cv::Point2d(GetUniform(rng, -0.03, 0.03), GetUniform(rng, -0.03, 0.03)) * image_size;
+    }
+    auto face_point = [&corners](const double& u, const double& v) {
+        const cv::Point2d p = corners[0] * ((1 - u) * (1 - v)) + corners[1] * (u * (1 - v))
+                            + corners[2] * (u * v) + corners[3] * ((1 - u) * v);
+        return cv::Point((int)std::lround(p.x), (int)std::lround(p.y));
+    };
+
+    const double gain = GetUniform(rng, 0.7, 1.1);
+    const double gap = 0.07;
+    for (int r = 0; r < dim; r ++) {
+        for (int c = 0; c < dim; c ++) {
+            const cv::Point sticker[4] = {
+                face_point((c + gap) / dim, (r + gap) / dim), face_point((c + 1 - gap) / dim, (r + gap) / dim),
+                face_point((c + 1 - gap) / dim, (r + 1 - gap) / dim), face_point((c + gap) / dim, (r + 1 - gap) / dim)
+            };
+            const char color_char = colors[(f * dim + r) * dim + c];
+            const cv::Vec3b& color = render_colors[std::strchr(rb::vision_color_chars, color_char) - rb::vision_color_chars];
+            cv::Scalar shade;
+            for (int i = 0; i < 3; i ++)
+                shade[i] = color[i] * gain * GetUniform(rng, 0.92, 1.08);
+            cv::fillConvexPoly(image, sticker, 4, shade);
+        }
+    }
+
+    cv::Mat image_noise(image.size(), CV_16SC3), noisy;
+    cv::randn(image_noise, cv::Scalar::all(0), cv::Scalar::all(noise));
+    image.convertTo(noisy, CV_16SC3);
+    noisy += image_noise;
+    noisy.convertTo(image, CV_8UC3);
+}
+
+
+static bool ReadPathList(const std::string& path, std::vector<std::string>& paths) {
+    std::ifstream in(path.c_str());
+    if (!in)
+        return false;
+    std::string image_path;
+    while (in >> image_path)
+        paths.push_back(image_path);
+    return (paths.size() % face_num) == 0;
+}
+
+
+static int ReadListedCubes(const std::string& list_path, const std::string& calibrate_path, const int& dim,
+                           const int& thread_num) {
+    rb::RubikCubeVision vision(dim);
+    std::vector<std::string> paths;
+    if (!calibrate_path.empty()) {
+        cv::Mat faces[face_num];
+        if (!ReadPathList(calibrate_path, paths) || paths.size() != face_num) {
+            std::cerr << "Can't read six calibration images from " << calibrate_path << std::endl;
+            return 1;
+        }
+        for (int f = 0; f < face_num; f ++)
+            faces[f] = cv::imread(paths[f], cv::IMREAD_COLOR);
+        if (!vision.Calibrate(faces)) {
+            std::cerr << "Can't find the faces of the calibration cube" << std::endl;
+            return 1;
+        }
+        paths.clear();
+    }
+    if (!ReadPathList(list_path, paths)) {
+        std::cerr << "Can't read six image paths per cube from " << list_path << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> colors;
+    const int read_num = vision.ExtractFiles(paths, colors, thread_num);
+    for (int i = 0; i < colors.size(); i ++) {
+        if (colors[i].empty())
+            std::cout << "-" << std::endl;
+        else
+            std::cout << colors[i] << " " << rb::GetCubeStateString(rb::ValidateCube(colors[i], dim)) << std::endl;
+    }
+    return (read_num == colors.size())? 0: 1;
+}
+
+
+int main(int argc, char* argv[]) {
+    int dim = 3;
+    int cube_num = 1000;
+    uint64_t seed = 1;
+    int image_size = 240;
+    double noise = 6;
+    int thread_num = 0;
+    std::string save_dir;
+    std::string list_path;
+    std::string calibrate_path;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--dim")
+            dim = std::atoi(argv[i + 1]);
+        else if (arg == "--count")
+            cube_num = std::atoi(argv[i + 1]);
+        else if (arg == "--seed")
+            seed = std::strtoull(argv[i + 1], NULL, 10);
+        else if (arg == "--size")
+            image_size = std::atoi(argv[i + 1]);
+        else if (arg == "--noise")
+            noise = std::atof(argv[i + 1]);
+        else if (arg == "--threads")
+            thread_num = std::atoi(argv[i + 1]);
+        else if (arg == "--save")
+            save_dir = argv[i + 1];
+        else if (arg == "--list")
+            list_path = argv[i + 1];
+        else if (arg == "--calibrate")
+            calibrate_path = argv[i + 1];
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((argc % 2) == 0 || dim < 2 || dim > 5 || cube_num <= 0 || image_size < 16 * dim || noise < 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (!list_path.empty())
+        return ReadListedCubes(list_path, calibrate_path, dim, thread_num);
+
+    std::mt19937 rng(seed);
+    cv::theRNG().state = seed;
+
+    // The reference colors are calibrated on a solved cube under the same kind of light
+    rb::RubikCubeVision vision(dim);
+    std::vector<cv::Mat> faces(face_num);
+    const std::string solved_colors = rb::RubikCube(dim).GetCubeString(true);
+    for (int f = 0; f < face_num; f ++)
+        RenderFace(solved_colors, f, dim, image_size, noise, rng, faces[f]);
+    if (!vision.Calibrate(&faces[0])) {
+        std::cerr << "Can't find the faces of the calibration cube" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> expected_colors(cube_num);
+    faces.resize(cube_num * face_num);
+    for (int i = 0; i < cube_num; i ++) {
+        rb::RubikCube cube(dim);
+        cube.Move(GenerateScramble(rng, dim, 25));
+        expected_colors[i] = cube.GetCubeString(true);
+        for (int f = 0; f < face_num; f ++)
+            RenderFace(expected_colors[i], f, dim, image_size, noise, rng, faces[i * face_num + f]);
+    }
+    if (!save_dir.empty()) {
+        std::ofstream list((save_dir + "/faces.txt").c_str());
+        for (int i = 0; i < faces.size(); i ++) {
+            std::ostringstream path;
+            path << save_dir << "/cube" << i / face_num << "_" << rb::vision_color_chars[i % face_num] << ".png";
+            cv::imwrite(path.str(), faces[i]);
+            list << path.str() << ((i % face_num == face_num - 1)? "\n": " ");
+        }
+    }
+
+    std::vector<std::string> colors(cube_num);
+    const auto start = std::chrono::steady_clock::now();
+    const int read_num = vision.ExtractBatch(&faces[0], cube_num, &colors[0], thread_num);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int wrong_num = 0;
+    for (int i = 0; i < cube_num; i ++) {
+        if (colors[i] == expected_colors[i])
+            continue;
+        if (wrong_num ++ < 10)
+            std::cerr << "cube " << i << ": read " << (colors[i].empty()? "nothing": colors[i])
+                      << ", expected " << expected_colors[i] << std::endl;
+    }
+    std::cout << dim << "x" << dim << "x" << dim << ": " << read_num << " of " << cube_num << " cubes read, "
+              << cube_num - wrong_num << " right, " << cube_num / seconds << " cubes/s" << std::endl;
+    return (wrong_num == 0)? 0: 1;
+}
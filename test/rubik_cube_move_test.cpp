@@ -0,0 +1,120 @@
+/*`
+ *   Copyright 2017 Toby Liu
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "rubik_cube.hpp"
+#include "rubik_cube_permutation.hpp"
+#include "rubik_cube_metric.hpp"
+#include "rubik_cube_packed.hpp"
+
+#include <string>
+#include <vector>
+#include <random>
+#include <iostream>
+
+/*
+ * Every way of applying moves has to leave a cube in the same state as
+ * RubikCube::Move(moves): the stickers and, after x, y and z, the face mappings.
+ */
+
+using namespace rb;
+
+static const int sequence_num = 200;
+static const int sequence_len = 30;
+static const char* turn_suffixes[3] = {"", "2", "'"};
+
+static int failure_num = 0;
+
+
+static std::string GetRandomMoves(std::mt19937& rng, const int& dim) {
+    // 2x2x2 has no inner slices
+    const std::string chars = (dim > 2)? move_chars: "ULFRBDxyz";
+    std::string moves;
+    for (int i = 0; i < sequence_len; i ++) {
+        if (i > 0)
+            moves += ' ';
+        moves += chars[rng() % chars.length()];
+        moves += turn_suffixes[rng() % 3];
+    }
+    return moves;
+}
+
+
+static bool IsSameCube(RubikCube& cube, RubikCube& other) {
+    if (cube.GetCubeString() != other.GetCubeString())
+        return false;
+    for (int f = 0; f < UNKNOWN_FACE; f ++)
+        if (cube.GetMappedFaceChar((CUBE_FACE)f) != other.GetMappedFaceChar((CUBE_FACE)f))
+            return false;
+    return cube.GetDim() > 3 || cube.GetMatchMask() == other.GetMatchMask();
+}
+
+
+static void Check(const bool& is_ok, const std::string& what, const int& dim, const std::string& moves) {
+    if (is_ok)
+        return;
+    failure_num ++;
+    std::cerr << what << " differs on " << dim << "x" << dim << "x" << dim << ": " << moves << std::endl;
+}
+
+
+int main() {
+    std::mt19937 rng(1);
+    // The standard metrics never rotate, a robot which can't reach B and D well does
+    std::vector<RubikCubeMetric> metrics;
+    metrics.push_back(RubikCubeMetric(QTM));
+    metrics.push_back(RubikCubeMetric(HTM));
+    metrics.push_back(RubikCubeMetric(STM));
+    metrics.push_back(RubikCubeMetric(HTM));
+    metrics.back().SetMoveCost('B', 5, 8);
+    metrics.back().SetMoveCost('D', 5, 8);
+    metrics.back().SetMoveCost('x', 1, 2);
+    metrics.back().SetMoveCost('y', 1, 2);
+
+    for (int dim = 2; dim <= 5; dim ++) {
+        for (int i = 0; i < sequence_num; i ++) {
+            const std::string moves = GetRandomMoves(rng, dim);
+            RubikCube cube(dim);
+            cube.Move(moves);
+
+            RubikCube perm_cube(dim);
+            perm_cube.Move(RubikCubePermutation::Compile(moves, dim));
+            Check(IsSameCube(cube, perm_cube), "Move(permutation)", dim, moves);
+
+            // The same in two halves, composed through Multiply
+            const int half = moves.find(' ', moves.length() / 2);
+            RubikCubePermutation perm(moves.substr(0, half), dim);
+            perm.Multiply(RubikCubePermutation(moves.substr(half), dim));
+            Check(perm == RubikCubePermutation(moves, dim), "Multiply", dim, moves);
+
+            RubikCubePermutation inverse = perm.GetInverse();
+            inverse.Multiply(perm);
+            Check(inverse.IsIdentity(), "GetInverse", dim, moves);
+
+            for (int m = 0; m < metrics.size(); m ++) {
+                RubikCube reexpressed_cube(dim);
+                reexpressed_cube.Move(metrics[m].Reexpress(moves));
+                Check(IsSameCube(cube, reexpressed_cube), "Reexpress", dim, moves);
+            }
+
+            RubikCubePacked packed(dim);
+            packed.Move(moves);
+            Check(packed.GetCubeString() == cube.GetCubeString(), "RubikCubePacked", dim, moves);
+        }
+    }
+
+    if (failure_num)
+        std::cerr << failure_num << " failures" << std::endl;
+    return (failure_num == 0)? 0: 1;
+}